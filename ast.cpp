@@ -0,0 +1,74 @@
+/* Out-of-line parts of the ast tree-building policy.
+*/
+
+#include <cstdlib>  // strtol, strtod
+#include <cstring>  // memcpy
+#include "ast.hpp"
+using std::string;
+
+namespace calc {
+
+size_t ast::hash(const ast_node& n)
+{
+    uint64_t h = 0;
+    for (uint64_t word : {n.kind | n.op << 8 | uint64_t(n.type) << 16 | uint64_t(n.ref) << 32,
+                          uint64_t(n.left) << 32 | n.right}) {
+        h ^= word;
+        h *= 0x9e3779b97f4a7c15;
+        h ^= h >> 29;
+    }
+    return h;
+}
+
+void ast::rehash(size_t size)
+{
+    table.assign(size, nil);
+    for (node_id n = 0; n < nodes.size(); n++) {
+        size_t slot = hash(nodes[n]) & (size - 1);
+        while (table[slot] != nil)
+            slot = (slot + 1) & (size - 1);
+        table[slot] = n;
+    }
+}
+
+ast::node ast::add(node_kind kind, token op, token type, uint32_t ref, node_id left, node_id right)
+{
+    ast_node node{kind, op, type, ref, left, right};
+    if (2 * (nodes.size() + 1) > table.size())     // keep the load at most 1/2
+        rehash(table.empty() ? 1024 : 2 * table.size());
+    size_t slot = hash(node) & (table.size() - 1);
+    for (; table[slot] != nil; slot = (slot + 1) & (table.size() - 1)) {
+        const ast_node& m = nodes[table[slot]];
+        if (m.kind == kind && m.op == op && m.type == type && m.ref == ref
+                && m.left == left && m.right == right)
+            return table[slot];
+    }
+    nodes.push_back(node);
+    return table[slot] = nodes.size() - 1;
+}
+
+ast::node ast::leaf(token kind, const string& image, uint32_t var)
+{
+    switch (kind) {
+        case t_inum: {
+            long value = strtol(image.c_str(), nullptr, 10);
+            auto found = int_ids.insert({value, ints.size()});
+            if (found.second)
+                ints.push_back(value);
+            return add(n_leaf, kind, t_int, found.first->second, nil, nil);
+        }
+        case t_rnum: {
+            double value = strtod(image.c_str(), nullptr);
+            uint64_t bits;
+            memcpy(&bits, &value, sizeof bits);
+            auto found = real_ids.insert({bits, reals.size()});
+            if (found.second)
+                reals.push_back(value);
+            return add(n_leaf, kind, t_real, found.first->second, nil, nil);
+        }
+        default:
+            return add(n_leaf, kind, var < vars.size() ? vars[var].type : t_int, var, nil, nil);
+    }
+}
+
+} // namespace calc
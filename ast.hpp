@@ -0,0 +1,171 @@
+/* Abstract syntax tree for the calculator language, and the passes
+   that work on it: a tree-walking interpreter, a C++ code generator,
+   and dataflow checks.
+*/
+
+#ifndef AST_HPP
+#define AST_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "scan.hpp"
+
+namespace calc {
+
+enum node_kind
+{
+    n_seq,      // left: stmt, right: rest of the list
+    n_decl,     // op: declared type, ref: variable, left: initial value
+    n_assign,   // ref: variable, left: value
+    n_read,     // op: declared type (t_eof if none), ref: variable
+    n_write,    // left: value
+    n_if,       // left: condition, right: body
+    n_while,    // left: condition, right: body
+    n_cond,     // op: relational operator, left, right: operands
+    n_binop,    // op: arithmetic operator, left, right: operands
+    n_convert,  // op: t_trunc or t_float, left: operand
+    n_leaf,     // op: t_id, t_inum or t_rnum, ref: variable, or value in ints/reals
+    n_error     // op t_semi: a statement with syntax errors, left: what was built
+                // of it, or nil; op t_eof: a missing expression or condition
+};
+
+typedef uint32_t node_id;
+const node_id nil = UINT32_MAX;     // missing child / empty list
+
+struct ast_node
+{
+    node_kind kind;
+    token op;
+    token type;     // t_int or t_real for expressions
+    uint32_t ref;
+    node_id left;
+    node_id right;
+};
+
+struct variable
+{
+    std::string name;
+    token type;     // t_int or t_real
+};
+
+/*
+    Nodes live in one arena and refer to each other by index.  ast
+    doubles as the parser's tree-building policy, so parser<ast> grows
+    one directly; the parser has already bound every name to its
+    variable and checked the types by then.
+    Nodes are hash-consed: add() returns the existing node when an
+    identical one (same kind, operator, type, reference and children)
+    is already in the arena, and equal literals share one value.  The
+    tree is therefore a DAG in which two subtrees are equal exactly
+    when their node_ids are.  Passes walk it as a tree, so a shared
+    subtree is visited once per place it appears.
+*/
+class ast
+{
+    std::unordered_map<std::string, uint32_t> symbol_ids;
+    std::unordered_map<long, uint32_t> int_ids;
+    std::unordered_map<uint64_t, uint32_t> real_ids;    // by bit pattern
+    std::vector<node_id> table;     // open addressing over nodes; nil is a free slot
+
+    node_id add(node_kind kind, token op, token type, uint32_t ref, node_id left, node_id right);
+    static size_t hash(const ast_node& n);
+    void rehash(size_t size);
+
+    token type_of(node_id n) const { return n == nil ? t_int : nodes[n].type; }
+
+    void define(uint32_t var, uint32_t id, token type)
+    {
+        if (vars.size() <= var)
+            vars.resize(var + 1);
+        vars[var] = variable{symbols[id], type};
+    }
+
+public:
+    typedef node_id node;
+    typedef uint32_t symbol;
+
+    std::vector<ast_node> nodes;
+    std::vector<std::string> symbols;   // interned names
+    std::vector<variable> vars;
+    std::vector<long> ints;             // distinct values of the i_num leaves
+    std::vector<double> reals;          // distinct values of the r_num leaves
+    std::vector<src_offset> stmt_offsets;   // where each statement starts, in source order
+    node_id root = nil;
+
+    symbol intern(const std::string& image)
+    {
+        auto found = symbol_ids.find(image);
+        if (found != symbol_ids.end())
+            return found->second;
+        symbols.push_back(image);
+        symbol_ids.insert({image, symbols.size() - 1});
+        return symbols.size() - 1;
+    }
+
+    void stmt_at(src_offset at) { stmt_offsets.push_back(at); }
+    node empty() { return nil; }
+    node program(node sl) { return root = sl; }
+    node stmt_list(const std::vector<node>& stmts)
+    {
+        node list = nil;
+        for (size_t i = stmts.size(); i-- > 0;)
+            list = add(n_seq, t_eof, t_eof, 0, stmts[i], list);
+        return list;
+    }
+    node decl(token type, symbol id, uint32_t var, node e)
+    {
+        define(var, id, type);
+        return add(n_decl, type, type, var, e, nil);
+    }
+    node assign(symbol, uint32_t var, node e) { return add(n_assign, t_gets, t_eof, var, e, nil); }
+    node read(token type, symbol id, uint32_t var)
+    {
+        if (type != t_eof)
+            define(var, id, type);
+        return add(n_read, type, t_eof, var, nil, nil);
+    }
+    node write(node e) { return add(n_write, t_write, t_eof, 0, e, nil); }
+    node if_stmt(node c, node sl) { return add(n_if, t_if, t_eof, 0, c, sl); }
+    node while_stmt(node c, node sl) { return add(n_while, t_while, t_eof, 0, c, sl); }
+    node cond(token op, node l, node r) { return add(n_cond, op, t_int, 0, l, r); }
+    node binop(token op, node l, node r)
+    {
+        token type = type_of(l) == t_real || type_of(r) == t_real ? t_real : t_int;
+        return add(n_binop, op, type, 0, l, r);
+    }
+    node convert(token conv, node e)
+    {
+        return add(n_convert, conv, conv == t_float ? t_real : t_int, 0, e, nil);
+    }
+    node leaf(token kind, const std::string& image, uint32_t var);
+    node missing() { return add(n_error, t_eof, t_eof, 0, nil, nil); }
+    node error(node partial) { return add(n_error, t_semi, t_eof, 0, partial, nil); }
+};
+
+// The passes below need a tree without syntax or type errors.
+
+// Execute the program by walking the tree.  A run that divides an int
+// by zero stops there and writes an error message to out; false then.
+bool run(const ast& tree, std::istream& in, std::ostream& out);
+
+// Run the program once for each line of in, many lines at a time.  A
+// line holds the values that one run reads; each run's output is one
+// line of out, with its values separated by spaces, or an error message
+// if the run divided an int by zero.
+void run_batch(const ast& tree, std::istream& in, std::ostream& out);
+
+// Write the program as a self-contained C++ translation unit.  Its int
+// divisions are plain C++ ones, so the compiled program traps (SIGFPE
+// on most machines) where run() and run_batch() report an error.
+void emit_cpp(const ast& tree, std::ostream& out);
+
+// Warn about variables that may be used before they are set and about
+// stored values that are never used.
+void check_flow(const ast& tree, const line_index& lines, const diagnostic_handler& report);
+
+} // namespace calc
+
+#endif
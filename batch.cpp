@@ -0,0 +1,467 @@
+/* Batched execution for the calculator language.
+   run_batch() runs one program over many input records.  The tree is
+   first compiled to a flat list of instructions on registers that hold
+   one value per lane; then batches of up to `width` records go through
+   it together, one record per lane.  if and while do not branch lane
+   by lane: each keeps a mask of the lanes still running, and stores,
+   reads and writes touch only those lanes.  Arithmetic runs over every
+   lane without branches, so the compiler can vectorize it.
+   A run that divides an int by zero (which would trap in --run and in
+   native code) stops there; its output line is an error message.
+*/
+
+#include <iostream>
+#include <algorithm>
+#include <climits>  // LONG_MIN
+#include <cstdlib>  // strtol, strtod
+#include <cctype>   // isspace
+#include "ast.hpp"
+using std::string;
+using std::vector;
+using std::unordered_map;
+
+namespace calc {
+
+namespace {
+
+const size_t width = 64;        // lanes (records) per batch
+
+enum opcode
+{
+    o_iadd, o_isub, o_imul, o_idiv,     // dst = a op b, on int registers
+    o_radd, o_rsub, o_rmul, o_rdiv,     // dst = a op b, on real registers
+    o_float,                            // real dst = int a
+    o_trunc,                            // int dst = real a
+    o_icmp, o_rcmp,                     // mask dst = a cmp b
+    o_icopy, o_rcopy,                   // dst = a, in the active lanes
+    o_iread, o_rread,                   // dst = next input value, in the active lanes
+    o_iwrite, o_rwrite,                 // output a, in the active lanes
+    o_push,                             // push top & mask a (the top itself if a is nil)
+    o_and,                              // top &= mask a
+    o_pop,
+    o_skip_none,                        // jump to a if no lane is active
+    o_jump                              // jump to a
+};
+
+struct instr
+{
+    opcode op;
+    token cmp;          // for o_icmp and o_rcmp
+    uint32_t dst;
+    uint32_t a;
+    uint32_t b;
+};
+
+struct reg
+{
+    uint32_t index;
+    bool real;
+};
+
+class batch
+{
+    const ast& tree;
+    std::istream& in;
+    std::ostream& out;
+
+    // The program.  Registers are numbered separately for ints, reals
+    // and masks.  Constants come first, then variables, then the
+    // temporaries of one statement, which the next statement reuses.
+    vector<instr> code;
+    vector<reg> var_regs;
+    uint32_t var_base[2] = {0, 0};      // first variable register, int and real
+    uint32_t temp_base[2] = {0, 0};     // first temporary
+    uint32_t temps[2] = {0, 0};         // in use by the current statement
+    uint32_t max_temps[2] = {0, 0};
+    uint32_t masks = 0;
+    uint32_t max_masks = 0;
+    uint32_t depth = 0;
+    uint32_t max_depth = 0;
+    unordered_map<node_id, reg> memo;   // values of the current statement's subtrees
+
+    // Storage, lane-major within each register.
+    vector<long> iregs;
+    vector<double> rregs;
+    vector<uint8_t> mregs;
+    vector<uint8_t> stack;              // the active-lane masks of enclosing ifs and whiles
+
+    // Input and output of the current batch, one column per field.
+    size_t lanes = 0;
+    vector<long> in_ints;
+    vector<double> in_reals;
+    size_t in_fields = 0;
+    uint32_t fields[width];             // input values in each lane's record
+    uint32_t cursor[width];             // the next one to read
+    struct cell { long i; double r; bool real; };
+    vector<cell> output;
+    size_t out_columns = 0;
+    uint32_t written[width];            // values written by each lane
+    bool failed[width];                 // lanes stopped by an int division that traps
+
+    size_t emit(opcode op, uint32_t dst, uint32_t a = 0, uint32_t b = 0, token cmp = t_eof)
+    {
+        code.push_back(instr{op, cmp, dst, a, b});
+        return code.size() - 1;
+    }
+
+    reg temp(bool real)
+    {
+        uint32_t& used = temps[real];
+        if (++used > max_temps[real])
+            max_temps[real] = used;
+        return reg{temp_base[real] + used - 1, real};
+    }
+
+    reg as_real(reg r)
+    {
+        if (r.real)
+            return r;
+        reg t = temp(true);
+        emit(o_float, t.index, r.index);
+        return t;
+    }
+
+    reg as_int(reg r)
+    {
+        if (!r.real)
+            return r;
+        reg t = temp(false);
+        emit(o_trunc, t.index, r.index);
+        return t;
+    }
+
+    // Subtrees are hash-consed, so a subtree that appears twice in one
+    // statement is computed once.
+    reg expr(node_id n)
+    {
+        auto found = memo.find(n);
+        if (found != memo.end())
+            return found->second;
+        const ast_node& e = tree.nodes[n];
+        reg r = {0, false};
+        switch (e.kind) {
+            case n_leaf:
+                if (e.op == t_id)
+                    r = var_regs[e.ref];
+                else if (e.op == t_inum)
+                    r = reg{e.ref, false};
+                else
+                    r = reg{e.ref, true};
+                break;
+            case n_convert:
+                r = e.op == t_trunc ? as_int(expr(e.left)) : as_real(expr(e.left));
+                break;
+            case n_binop: {
+                bool real = e.type == t_real;
+                reg a = expr(e.left);
+                reg b = expr(e.right);
+                if (real) {
+                    a = as_real(a);
+                    b = as_real(b);
+                }
+                int op = e.op == t_add ? 0 : e.op == t_sub ? 1 : e.op == t_mul ? 2 : 3;
+                r = temp(real);
+                emit(opcode((real ? o_radd : o_iadd) + op), r.index, a.index, b.index);
+                break;
+            }
+            default:
+                break;
+        }
+        memo[n] = r;
+        return r;
+    }
+
+    uint32_t cond(node_id n)
+    {
+        const ast_node& c = tree.nodes[n];
+        reg a = expr(c.left);
+        reg b = expr(c.right);
+        uint32_t m = masks++;
+        if (masks > max_masks)
+            max_masks = masks;
+        if (!a.real && !b.real)
+            emit(o_icmp, m, a.index, b.index, c.op);
+        else
+            emit(o_rcmp, m, as_real(a).index, as_real(b).index, c.op);
+        return m;
+    }
+
+    void nest(node_id body)
+    {
+        if (++depth > max_depth)
+            max_depth = depth;
+        block(body);
+        depth--;
+    }
+
+    void block(node_id list)
+    {
+        for (; list != nil; list = tree.nodes[list].right) {
+            node_id n = tree.nodes[list].left;
+            if (n == nil)
+                continue;
+            const ast_node& s = tree.nodes[n];
+            memo.clear();
+            temps[0] = temps[1] = 0;
+            masks = 0;
+            switch (s.kind) {
+                case n_decl:
+                case n_assign: {
+                    reg v = var_regs[s.ref];
+                    reg value = v.real ? as_real(expr(s.left)) : as_int(expr(s.left));
+                    emit(v.real ? o_rcopy : o_icopy, v.index, value.index);
+                    break;
+                }
+                case n_read: {
+                    reg v = var_regs[s.ref];
+                    emit(v.real ? o_rread : o_iread, v.index);
+                    break;
+                }
+                case n_write: {
+                    reg value = expr(s.left);
+                    emit(value.real ? o_rwrite : o_iwrite, 0, value.index);
+                    break;
+                }
+                case n_if: {
+                    emit(o_push, 0, cond(s.left));
+                    size_t skip = emit(o_skip_none, 0);
+                    nest(s.right);
+                    code[skip].a = code.size();
+                    emit(o_pop, 0);
+                    break;
+                }
+                case n_while: {
+                    emit(o_push, 0, nil);
+                    size_t head = code.size();
+                    emit(o_and, 0, cond(s.left));
+                    size_t skip = emit(o_skip_none, 0);
+                    nest(s.right);
+                    emit(o_jump, 0, head);
+                    code[skip].a = code.size();
+                    emit(o_pop, 0);
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+    }
+
+    void compile()
+    {
+        // constants are registers that are never written
+        var_base[0] = tree.ints.size();
+        var_base[1] = tree.reals.size();
+        uint32_t count[2] = {0, 0};
+        for (const variable& v : tree.vars) {
+            bool real = v.type != t_int;
+            var_regs.push_back(reg{var_base[real] + count[real]++, real});
+        }
+        for (int real = 0; real < 2; real++)
+            temp_base[real] = var_base[real] + count[real];
+        block(tree.root);
+
+        iregs.resize((temp_base[0] + max_temps[0]) * width);
+        rregs.resize((temp_base[1] + max_temps[1]) * width);
+        mregs.resize(max_masks * width);
+        stack.resize((max_depth + 1) * width);
+        for (size_t k = 0; k < tree.ints.size(); k++)
+            std::fill_n(&iregs[k * width], width, tree.ints[k]);
+        for (size_t k = 0; k < tree.reals.size(); k++)
+            std::fill_n(&rregs[k * width], width, tree.reals[k]);
+    }
+
+    // Read up to width lines, one record each.  False at end of input.
+    bool load()
+    {
+        string line;
+        for (lanes = 0; lanes < width && std::getline(in, line); lanes++) {
+            uint32_t field = 0;
+            for (const char* p = line.c_str(); ; field++) {
+                while (isspace((unsigned char) *p))
+                    p++;
+                if (!*p)
+                    break;
+                if (field == in_fields) {
+                    in_fields++;
+                    in_ints.resize(in_fields * width);
+                    in_reals.resize(in_fields * width);
+                }
+                char* end;
+                in_ints[field * width + lanes] = strtol(p, &end, 10);
+                in_reals[field * width + lanes] = strtod(p, &end);
+                for (p = end; *p && !isspace((unsigned char) *p); p++)
+                    ;
+            }
+            fields[lanes] = field;
+        }
+        return lanes > 0;
+    }
+
+    template <class T>
+    void read(T* dst, const vector<T>& column, const uint8_t* active)
+    {
+        for (size_t l = 0; l < width; l++)
+            if (active[l]) {
+                uint32_t f = cursor[l]++;
+                dst[l] = f < fields[l] ? column[f * width + l] : 0;
+            }
+    }
+
+    void write(const instr& i, const uint8_t* active)
+    {
+        output.resize((out_columns + 1) * width);
+        bool any = false;
+        for (size_t l = 0; l < width; l++)
+            if (active[l]) {
+                cell& c = output[written[l]++ * width + l];
+                if (i.op == o_iwrite)
+                    c = cell{iregs[i.a * width + l], 0, false};
+                else
+                    c = cell{0, rregs[i.a * width + l], true};
+                if (written[l] > out_columns)
+                    any = true;
+            }
+        if (any)
+            out_columns++;
+    }
+
+    template <class T>
+    static void compare(uint8_t* m, const T* a, const T* b, token op)
+    {
+        switch (op) {
+            case t_eq: for (size_t l = 0; l < width; l++) m[l] = a[l] == b[l]; break;
+            case t_neq: for (size_t l = 0; l < width; l++) m[l] = a[l] != b[l]; break;
+            case t_lt: for (size_t l = 0; l < width; l++) m[l] = a[l] < b[l]; break;
+            case t_gt: for (size_t l = 0; l < width; l++) m[l] = a[l] > b[l]; break;
+            case t_le: for (size_t l = 0; l < width; l++) m[l] = a[l] <= b[l]; break;
+            default: for (size_t l = 0; l < width; l++) m[l] = a[l] >= b[l]; break;
+        }
+    }
+
+    void exec()
+    {
+        uint8_t* top = stack.data();
+        for (size_t l = 0; l < width; l++) {
+            top[l] = l < lanes;
+            cursor[l] = written[l] = 0;
+            failed[l] = false;
+        }
+        out_columns = 0;
+        std::fill(iregs.begin() + var_base[0] * width, iregs.begin() + temp_base[0] * width, 0);
+        std::fill(rregs.begin() + var_base[1] * width, rregs.begin() + temp_base[1] * width, 0);
+
+        for (size_t pc = 0; pc < code.size(); pc++) {
+            const instr& i = code[pc];
+            long* id = &iregs[0] + i.dst * width;
+            const long* ia = &iregs[0] + i.a * width;
+            const long* ib = &iregs[0] + i.b * width;
+            double* rd = &rregs[0] + i.dst * width;
+            const double* ra = &rregs[0] + i.a * width;
+            const double* rb = &rregs[0] + i.b * width;
+            typedef unsigned long ul;   // lanes that are masked off may overflow
+            switch (i.op) {
+                case o_iadd: for (size_t l = 0; l < width; l++) id[l] = ul(ia[l]) + ul(ib[l]); break;
+                case o_isub: for (size_t l = 0; l < width; l++) id[l] = ul(ia[l]) - ul(ib[l]); break;
+                case o_imul: for (size_t l = 0; l < width; l++) id[l] = ul(ia[l]) * ul(ib[l]); break;
+                case o_idiv:
+                    // lanes that would trap divide by 1; active ones stop
+                    for (size_t l = 0; l < width; l++) {
+                        bool traps = ib[l] == 0 || (ib[l] == -1 && ia[l] == LONG_MIN);
+                        id[l] = traps ? ia[l] : ia[l] / ib[l];
+                        if (traps && top[l])
+                            fail(l, top);
+                    }
+                    break;
+                case o_radd: for (size_t l = 0; l < width; l++) rd[l] = ra[l] + rb[l]; break;
+                case o_rsub: for (size_t l = 0; l < width; l++) rd[l] = ra[l] - rb[l]; break;
+                case o_rmul: for (size_t l = 0; l < width; l++) rd[l] = ra[l] * rb[l]; break;
+                case o_rdiv: for (size_t l = 0; l < width; l++) rd[l] = ra[l] / rb[l]; break;
+                case o_float: for (size_t l = 0; l < width; l++) rd[l] = ia[l]; break;
+                case o_trunc: for (size_t l = 0; l < width; l++) id[l] = (long) ra[l]; break;
+                case o_icmp: compare(&mregs[i.dst * width], ia, ib, i.cmp); break;
+                case o_rcmp: compare(&mregs[i.dst * width], ra, rb, i.cmp); break;
+                case o_icopy: for (size_t l = 0; l < width; l++) id[l] = top[l] ? ia[l] : id[l]; break;
+                case o_rcopy: for (size_t l = 0; l < width; l++) rd[l] = top[l] ? ra[l] : rd[l]; break;
+                case o_iread: read(id, in_ints, top); break;
+                case o_rread: read(rd, in_reals, top); break;
+                case o_iwrite:
+                case o_rwrite: write(i, top); break;
+                case o_push: {
+                    uint8_t* next = top + width;
+                    if (i.a == nil)
+                        std::copy(top, top + width, next);
+                    else
+                        for (size_t l = 0; l < width; l++)
+                            next[l] = top[l] & mregs[i.a * width + l];
+                    top = next;
+                    break;
+                }
+                case o_and:
+                    for (size_t l = 0; l < width; l++)
+                        top[l] &= mregs[i.a * width + l];
+                    break;
+                case o_pop: top -= width; break;
+                case o_skip_none: {
+                    uint8_t any = 0;
+                    for (size_t l = 0; l < width; l++)
+                        any |= top[l];
+                    if (!any)
+                        pc = i.a - 1;
+                    break;
+                }
+                case o_jump: pc = i.a - 1; break;
+            }
+        }
+    }
+
+    // Take lane l out of every enclosing mask, so it runs no further.
+    void fail(size_t l, uint8_t* top)
+    {
+        failed[l] = true;
+        for (uint8_t* m = stack.data(); m <= top; m += width)
+            m[l] = 0;
+    }
+
+    void flush()
+    {
+        for (size_t l = 0; l < lanes; l++) {
+            if (failed[l]) {
+                out << "error: division by zero\n";
+                continue;
+            }
+            for (uint32_t c = 0; c < written[l]; c++) {
+                const cell& v = output[c * width + l];
+                if (c > 0)
+                    out << ' ';
+                if (v.real)
+                    out << v.r;
+                else
+                    out << v.i;
+            }
+            out << '\n';
+        }
+    }
+
+public:
+    batch(const ast& tree, std::istream& in, std::ostream& out)
+        : tree(tree), in(in), out(out) {}
+
+    void run()
+    {
+        compile();
+        while (load()) {
+            exec();
+            flush();
+        }
+    }
+};
+
+} // namespace
+
+void run_batch(const ast& tree, std::istream& in, std::ostream& out)
+{
+    batch(tree, in, out).run();
+}
+
+} // namespace calc
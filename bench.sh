@@ -0,0 +1,75 @@
+#!/bin/bash
+# Compare native execution (--emit-cpp, then g++) with tree-walking
+# execution (--run) on the `correct` sample and on generated loop-heavy
+# programs.  Both must print the same output.
+# Usage: ./bench.sh        (after make)
+
+set -e
+CXX=${CXX:-g++}
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+# A loop over real arithmetic with trunc/float and a nested if.
+cat > "$work/series" <<'EOF'
+read int n;
+real s := 0.0;
+int i := 0;
+while i < n do
+    s := s + float(i) / (float(i) + 1.5) * 2.0;
+    if trunc(s) > 1000000 then
+        s := s / 2.0;
+    end;
+    i := i + 1;
+end;
+write s;
+EOF
+
+# $1 accumulators, all updated in the body of one counted loop.  Each
+# is reduced modulo 1009 every time, so none of them can overflow.
+gen_accumulators() {
+    echo "read int n;"
+    for ((k = 0; k < $1; k++)); do
+        echo "int a$k := $k;"
+    done
+    echo "int i := 0;"
+    echo "while i < n do"
+    for ((k = 0; k < $1; k++)); do
+        echo "    a$k := (a$k * 7 + i + $k) - ((a$k * 7 + i + $k) / 1009) * 1009;"
+    done
+    echo "    i := i + 1;"
+    echo "end;"
+    for ((k = 0; k < $1; k += 8)); do
+        echo "write a$k;"
+    done
+}
+gen_accumulators 64 > "$work/accumulators"
+
+cp correct "$work/correct"
+
+TIMEFORMAT=%R
+printf "%-14s %10s %10s %10s\n" program input "run (s)" "native (s)"
+for case in "correct 800" "series 20000000" "accumulators 200000"; do
+    set -- $case
+    ./parse --emit-cpp < "$work/$1" > "$work/$1.cpp"
+    $CXX -O2 -o "$work/$1.native" "$work/$1.cpp"
+    walk=$( { time ./parse --run "$work/$1" <<< "$2" > "$work/$1.walk.out"; } 2>&1 )
+    native=$( { time "$work/$1.native" <<< "$2" > "$work/$1.native.out"; } 2>&1 )
+    cmp -s "$work/$1.walk.out" "$work/$1.native.out" || { echo "$1: outputs differ"; exit 1; }
+    printf "%-14s %10s %10s %10s\n" "$1" "$2" "$walk" "$native"
+done
+
+# About the same series work split into 100000 records, run a batch of
+# records at a time (--run-batch) vs. all at once (--run).  Record counts
+# vary from 1 to 400, so lanes leave the loop at different times and the
+# masks diverge.
+awk 'BEGIN { for (r = 0; r < 100000; r++) print r * 7919 % 400 + 1 }' > "$work/records"
+total=$(awk '{ t += $1 } END { print t }' "$work/records")
+batch=$( { time ./parse --run-batch "$work/series" < "$work/records" > "$work/batch.out"; } 2>&1 )
+walk=$( { time ./parse --run "$work/series" <<< "$total" > /dev/null; } 2>&1 )
+for r in 1 2 3 64 65 100000; do
+    ./parse --run "$work/series" < <(sed -n "${r}p" "$work/records") \
+        | cmp -s - <(sed -n "${r}p" "$work/batch.out") \
+        || { echo "series: batch output differs for record $r"; exit 1; }
+done
+printf "\n%-14s %10s %10s %10s\n" program records "run (s)" "batch (s)"
+printf "%-14s %10s %10s %10s\n" series 100000 "$walk" "$batch"
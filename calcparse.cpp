@@ -0,0 +1,59 @@
+/* libcalcparse: parse_program and check_program.
+*/
+
+#include "calcparse.hpp"
+#include "parse.hpp"
+
+namespace calc {
+
+namespace {
+
+template <class Tree>
+void parse_into(parser<Tree>& p)
+{
+    p.build_eps();
+    p.build_first();
+    p.build_follow();
+    p.program();
+}
+
+// Parse from source (a stream, or a begin and end pointer).
+template <class... Source>
+parse_result parse_from(Source&&... source)
+{
+    parse_result result;
+    parser<ast> p(source..., [&result](const diagnostic& d) {
+        result.diagnostics.push_back(d);
+    });
+    parse_into(p);
+    result.tree = std::move(p.get_tree());
+    result.lines = p.lines();
+    return result;
+}
+
+} // namespace
+
+parse_result parse_program(std::istream& in)
+{
+    return parse_from(in);
+}
+
+parse_result parse_program(const char* begin, const char* end)
+{
+    return parse_from(begin, end);
+}
+
+parse_result parse_program(const string& source)
+{
+    return parse_program(source.data(), source.data() + source.size());
+}
+
+bool check_program(const char* begin, const char* end,
+                   const diagnostic_handler& report)
+{
+    parser<no_tree> p(begin, end, report);
+    parse_into(p);
+    return !p.has_errors();
+}
+
+} // namespace calc
@@ -0,0 +1,44 @@
+/* Embeddable interface to the calculator parser (libcalcparse).
+   Nothing here reads cin or writes cout, and separate calls share no
+   state, so a program can run any number of parses at once, on as
+   many threads as it likes.  The library's names are all in namespace
+   calc, and its headers declare nothing outside it.
+*/
+
+#ifndef CALCPARSE_HPP
+#define CALCPARSE_HPP
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "scan.hpp"
+#include "ast.hpp"
+
+namespace calc {
+
+struct parse_result
+{
+    ast tree;                               // best effort if there were errors (see n_error)
+    std::vector<diagnostic> diagnostics;    // in the order they were found
+    line_index lines;                       // to place later passes' diagnostics
+
+    // Only then can the tree go to run(), emit_cpp() or check_flow().
+    bool ok() const { return diagnostics.empty(); }
+};
+
+// Parse the program in [begin, end).  The bytes are read in place.
+parse_result parse_program(const char* begin, const char* end);
+parse_result parse_program(const std::string& source);
+
+// Parse the program read from in.
+parse_result parse_program(std::istream& in);
+
+// Only check the program in [begin, end); no tree is built.  Each
+// diagnostic goes to report as soon as it is found.  True if there
+// were none.
+bool check_program(const char* begin, const char* end,
+                   const diagnostic_handler& report);
+
+} // namespace calc
+
+#endif
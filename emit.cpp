@@ -0,0 +1,126 @@
+/* C++ code generator for the calculator language.
+   Every variable becomes a typed local of main(), named after its
+   source name and its index so that redeclared and hidden names stay
+   apart.  The result needs nothing but the standard library:
+       ./parse --emit-cpp < prog > prog.cpp && g++ -O2 -o prog prog.cpp
+   Int division is left to C++, so the program traps on a zero divisor
+   (or LONG_MIN / -1) where run() stops with an error.
+*/
+
+#include <iostream>
+#include <cstdio>   // snprintf
+#include "ast.hpp"
+using std::ostream;
+using std::to_string;
+using std::string;
+
+namespace calc {
+
+namespace {
+
+class emitter
+{
+    const ast& tree;
+    ostream& out;
+
+    string var(uint32_t v)
+    {
+        return tree.vars[v].name + "_" + to_string(v);
+    }
+
+    string expr(node_id n)
+    {
+        const ast_node& e = tree.nodes[n];
+        switch (e.kind) {
+            case n_leaf:
+                if (e.op == t_id)
+                    return var(e.ref);
+                if (e.op == t_inum)
+                    return to_string(tree.ints[e.ref]) + "L";
+                else {
+                    char image[32];     // hex float: exact, and always a double literal
+                    snprintf(image, sizeof image, "%a", tree.reals[e.ref]);
+                    return image;
+                }
+            case n_convert:
+                return (e.op == t_trunc ? "(long)(" : "(double)(") + expr(e.left) + ")";
+            case n_binop:
+            case n_cond:
+                return "(" + expr(e.left) + " " + op_image(e.op) + " " + expr(e.right) + ")";
+            default:
+                return "0";
+        }
+    }
+
+    static const char* op_image(token op)
+    {
+        switch (op) {
+            case t_add: return "+";
+            case t_sub: return "-";
+            case t_mul: return "*";
+            case t_div: return "/";
+            case t_eq: return "==";
+            case t_neq: return "!=";
+            case t_lt: return "<";
+            case t_gt: return ">";
+            case t_le: return "<=";
+            default: return ">=";
+        }
+    }
+
+    void block(node_id list, const string& indent)
+    {
+        for (; list != nil; list = tree.nodes[list].right) {
+            node_id n = tree.nodes[list].left;
+            if (n == nil)
+                continue;
+            const ast_node& s = tree.nodes[n];
+            switch (s.kind) {
+                case n_decl:
+                case n_assign:
+                    out << indent << var(s.ref) << " = " << expr(s.left) << ";\n";
+                    break;
+                case n_read:
+                    out << indent << "std::cin >> " << var(s.ref) << ";\n";
+                    break;
+                case n_write:
+                    out << indent << "std::cout << " << expr(s.left) << " << '\\n';\n";
+                    break;
+                case n_if:
+                case n_while:
+                    out << indent << (s.kind == n_if ? "if " : "while ")
+                        << expr(s.left) << " {\n";
+                    block(s.right, indent + "    ");
+                    out << indent << "}\n";
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+public:
+    emitter(const ast& tree, ostream& out) : tree(tree), out(out) {}
+
+    void emit()
+    {
+        out << "#include <iostream>\n\n"
+            << "int main() {\n"
+            << "    std::ios::sync_with_stdio(false);\n";
+        for (uint32_t v = 0; v < tree.vars.size(); v++)
+            out << "    " << (tree.vars[v].type == t_int ? "long " : "double ")
+                << var(v) << " = 0;\n";
+        block(tree.root, "    ");
+        out << "    return 0;\n"
+            << "}\n";
+    }
+};
+
+} // namespace
+
+void emit_cpp(const ast& tree, ostream& out)
+{
+    emitter(tree, out).emit();
+}
+
+} // namespace calc
@@ -0,0 +1,274 @@
+/* Dataflow warnings for the calculator language.
+   The statement lists, ifs and whiles of the tree become a control-flow
+   graph of basic blocks.  Two worklist analyses run over it, each with
+   one dense bitset of variable indexes per block: definite assignment
+   (forward, must) and liveness (backward, may).  A final pass through
+   each block finds uses of variables that are not yet set on every
+   path, and stores whose value is dead.
+*/
+
+#include <algorithm>
+#include <deque>
+#include "ast.hpp"
+using std::deque;
+using std::string;
+using std::vector;
+
+namespace calc {
+
+namespace {
+
+// A dense set of variable indexes.
+class var_set
+{
+    vector<uint64_t> words;
+
+public:
+    explicit var_set(size_t vars = 0, bool full = false)
+        : words((vars + 63) / 64, full ? ~uint64_t(0) : 0) {}
+
+    bool has(uint32_t v) const { return words[v >> 6] >> (v & 63) & 1; }
+    void add(uint32_t v) { words[v >> 6] |= uint64_t(1) << (v & 63); }
+    void remove(uint32_t v) { words[v >> 6] &= ~(uint64_t(1) << (v & 63)); }
+
+    void unite(const var_set& other)
+    {
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] |= other.words[i];
+    }
+    void intersect(const var_set& other)
+    {
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] &= other.words[i];
+    }
+    void subtract(const var_set& other)
+    {
+        for (size_t i = 0; i < words.size(); i++)
+            words[i] &= ~other.words[i];
+    }
+    bool operator!=(const var_set& other) const { return words != other.words; }
+};
+
+// A simple statement, or the condition of an if or while.
+struct item
+{
+    node_id n;
+    uint32_t stmt;      // which statement, in source order
+};
+
+struct block
+{
+    vector<item> items;
+    vector<uint32_t> succs;
+    vector<uint32_t> preds;
+    var_set defs;       // variables set in the block
+    var_set uses;       // variables used in the block before it sets them
+    var_set set_in;     // variables set on every path into the block
+    var_set live_out;   // variables whose values may still be used after it
+};
+
+class flow
+{
+    const ast& tree;
+    const line_index& lines;
+    vector<block> blocks;
+    uint32_t stmts = 0;
+    vector<diagnostic> warnings;
+
+    uint32_t new_block()
+    {
+        blocks.emplace_back();
+        return blocks.size() - 1;
+    }
+
+    void edge(uint32_t from, uint32_t to)
+    {
+        blocks[from].succs.push_back(to);
+        blocks[to].preds.push_back(from);
+    }
+
+    // Append the statements of list to block b; return the block that
+    // control reaches at the end of the list.
+    uint32_t build(node_id list, uint32_t b)
+    {
+        for (; list != nil; list = tree.nodes[list].right) {
+            uint32_t stmt = stmts++;
+            node_id n = tree.nodes[list].left;
+            if (n == nil)
+                continue;
+            const ast_node& s = tree.nodes[n];
+            if (s.kind == n_if) {
+                blocks[b].items.push_back(item{s.left, stmt});
+                uint32_t then = new_block();
+                edge(b, then);
+                uint32_t end = build(s.right, then);
+                uint32_t join = new_block();
+                edge(b, join);
+                edge(end, join);
+                b = join;
+            }
+            else if (s.kind == n_while) {
+                uint32_t head = new_block();
+                edge(b, head);
+                blocks[head].items.push_back(item{s.left, stmt});
+                uint32_t body = new_block();
+                edge(head, body);
+                edge(build(s.right, body), head);
+                b = new_block();
+                edge(head, b);
+            }
+            else if (s.kind != n_error)
+                blocks[b].items.push_back(item{n, stmt});
+        }
+        return b;
+    }
+
+    template <class F>
+    void each_use(node_id n, F f) const
+    {
+        if (n == nil)
+            return;
+        const ast_node& e = tree.nodes[n];
+        if (e.kind == n_leaf) {
+            if (e.op == t_id)
+                f(e.ref);
+            return;
+        }
+        each_use(e.left, f);
+        each_use(e.right, f);
+    }
+
+    // The expression an item reads, and the variable it sets (or nil).
+    node_id used(const item& it) const
+    {
+        const ast_node& s = tree.nodes[it.n];
+        return s.kind == n_read ? nil : s.kind == n_cond ? it.n : s.left;
+    }
+
+    uint32_t defined(const item& it) const
+    {
+        node_kind kind = tree.nodes[it.n].kind;
+        return kind == n_decl || kind == n_assign || kind == n_read ? tree.nodes[it.n].ref : nil;
+    }
+
+    void summarize(block& b)
+    {
+        size_t vars = tree.vars.size();
+        b.defs = b.uses = b.live_out = var_set(vars);
+        b.set_in = var_set(vars, true);
+        for (const item& it : b.items) {
+            each_use(used(it), [&](uint32_t v) {
+                if (!b.defs.has(v))
+                    b.uses.add(v);
+            });
+            uint32_t v = defined(it);
+            if (v != nil)
+                b.defs.add(v);
+        }
+    }
+
+    void assigned()
+    {
+        blocks[0].set_in = var_set(tree.vars.size());
+        deque<uint32_t> work;
+        for (uint32_t b = 0; b < blocks.size(); b++)
+            work.push_back(b);
+        while (!work.empty()) {
+            block& b = blocks[work.front()];
+            work.pop_front();
+            var_set out = b.set_in;
+            out.unite(b.defs);
+            for (uint32_t s : b.succs) {
+                var_set in = blocks[s].set_in;
+                in.intersect(out);
+                if (in != blocks[s].set_in) {
+                    blocks[s].set_in = in;
+                    work.push_back(s);
+                }
+            }
+        }
+    }
+
+    void liveness()
+    {
+        deque<uint32_t> work;
+        for (uint32_t b = blocks.size(); b-- > 0; )
+            work.push_back(b);
+        while (!work.empty()) {
+            block& b = blocks[work.front()];
+            work.pop_front();
+            var_set in = b.live_out;
+            in.subtract(b.defs);
+            in.unite(b.uses);
+            for (uint32_t p : b.preds) {
+                var_set out = blocks[p].live_out;
+                out.unite(in);
+                if (out != blocks[p].live_out) {
+                    blocks[p].live_out = out;
+                    work.push_back(p);
+                }
+            }
+        }
+    }
+
+    void warn(const item& it, const string& message)
+    {
+        src_offset at = it.stmt < tree.stmt_offsets.size() ? tree.stmt_offsets[it.stmt] : 0;
+        warnings.push_back(diagnostic{at, lines.locate(at), "warning: " + message});
+    }
+
+    void report(const block& b)
+    {
+        var_set set = b.set_in;
+        for (const item& it : b.items) {
+            each_use(used(it), [&](uint32_t v) {
+                if (!set.has(v)) {
+                    warn(it, tree.vars[v].name + " may be used before it is set");
+                    set.add(v);     // once is enough
+                }
+            });
+            uint32_t v = defined(it);
+            if (v != nil)
+                set.add(v);
+        }
+
+        var_set live = b.live_out;
+        for (size_t i = b.items.size(); i-- > 0; ) {
+            const item& it = b.items[i];
+            uint32_t v = defined(it);
+            if (v != nil) {
+                if (!live.has(v) && tree.nodes[it.n].kind != n_read)
+                    warn(it, "value stored in " + tree.vars[v].name + " is never used");
+                live.remove(v);
+            }
+            each_use(used(it), [&](uint32_t u) { live.add(u); });
+        }
+    }
+
+public:
+    flow(const ast& tree, const line_index& lines) : tree(tree), lines(lines) {}
+
+    vector<diagnostic> check()
+    {
+        build(tree.root, new_block());
+        for (block& b : blocks)
+            summarize(b);
+        assigned();
+        liveness();
+        for (const block& b : blocks)
+            report(b);
+        std::stable_sort(warnings.begin(), warnings.end(),
+                         [](const diagnostic& a, const diagnostic& b) { return a.offset < b.offset; });
+        return warnings;
+    }
+};
+
+} // namespace
+
+void check_flow(const ast& tree, const line_index& lines, const diagnostic_handler& report)
+{
+    for (const diagnostic& d : flow(tree, lines).check())
+        report(d);
+}
+
+} // namespace calc
@@ -0,0 +1,176 @@
+/* Tree-walking interpreter for the calculator language.
+   Arithmetic follows C++ (int / int truncates), which keeps it in step
+   with emit_cpp().  The parser has already rejected any program that
+   mixes int and real without trunc or float.  Where C++ would trap (an
+   int divided by zero, or LONG_MIN by -1) the run stops with an error.
+*/
+
+#include <iostream>
+#include <climits>  // LONG_MIN
+#include "ast.hpp"
+using std::vector;
+
+namespace calc {
+
+namespace {
+
+class interpreter
+{
+    const ast& tree;
+    std::istream& in;
+    std::ostream& out;
+    vector<long> ints;      // int variables, by variable index
+    vector<double> reals;   // real variables, by variable index
+    bool failed = false;    // an int division would have trapped
+
+    long eval_int(node_id n)
+    {
+        const ast_node& e = tree.nodes[n];
+        switch (e.kind) {
+            case n_leaf:
+                return e.op == t_id ? ints[e.ref] : tree.ints[e.ref];
+            case n_convert:
+                return tree.nodes[e.left].type == t_real ? (long) eval_real(e.left)
+                                                         : eval_int(e.left);
+            case n_binop: {
+                long l = eval_int(e.left);
+                long r = eval_int(e.right);
+                switch (e.op) {
+                    case t_add: return l + r;
+                    case t_sub: return l - r;
+                    case t_mul: return l * r;
+                    default:
+                        if (r == 0 || (r == -1 && l == LONG_MIN)) {
+                            failed = true;
+                            return 0;
+                        }
+                        return l / r;
+                }
+            }
+            default:
+                return 0;
+        }
+    }
+
+    double eval_real(node_id n)
+    {
+        if (tree.nodes[n].type == t_int)
+            return eval_int(n);
+        const ast_node& e = tree.nodes[n];
+        switch (e.kind) {
+            case n_leaf:
+                return e.op == t_id ? reals[e.ref] : tree.reals[e.ref];
+            case n_convert:
+                return eval_real(e.left);
+            case n_binop: {
+                double l = eval_real(e.left);
+                double r = eval_real(e.right);
+                switch (e.op) {
+                    case t_add: return l + r;
+                    case t_sub: return l - r;
+                    case t_mul: return l * r;
+                    default: return l / r;
+                }
+            }
+            default:
+                return 0;
+        }
+    }
+
+    template <class T>
+    static bool compare(token op, T l, T r)
+    {
+        switch (op) {
+            case t_eq: return l == r;
+            case t_neq: return l != r;
+            case t_lt: return l < r;
+            case t_gt: return l > r;
+            case t_le: return l <= r;
+            default: return l >= r;
+        }
+    }
+
+    bool eval_cond(node_id n)
+    {
+        const ast_node& c = tree.nodes[n];
+        if (tree.nodes[c.left].type == t_int && tree.nodes[c.right].type == t_int)
+            return compare(c.op, eval_int(c.left), eval_int(c.right));
+        return compare(c.op, eval_real(c.left), eval_real(c.right));
+    }
+
+    void store(node_id n, node_id value)
+    {
+        uint32_t v = tree.nodes[n].ref;
+        if (tree.vars[v].type == t_int)
+            ints[v] = tree.nodes[value].type == t_real ? (long) eval_real(value)
+                                                       : eval_int(value);
+        else
+            reals[v] = eval_real(value);
+    }
+
+    void exec(node_id list)
+    {
+        for (; list != nil && !failed; list = tree.nodes[list].right) {
+            node_id n = tree.nodes[list].left;
+            if (n == nil)
+                continue;
+            const ast_node& s = tree.nodes[n];
+            switch (s.kind) {
+                case n_decl:
+                case n_assign:
+                    store(n, s.left);
+                    break;
+                case n_read:
+                    if (tree.vars[s.ref].type == t_int)
+                        in >> ints[s.ref];
+                    else
+                        in >> reals[s.ref];
+                    break;
+                case n_write:
+                    if (tree.nodes[s.left].type == t_int) {
+                        long value = eval_int(s.left);
+                        if (!failed)
+                            out << value << '\n';
+                    }
+                    else {
+                        double value = eval_real(s.left);
+                        if (!failed)
+                            out << value << '\n';
+                    }
+                    break;
+                case n_if:
+                    if (eval_cond(s.left) && !failed)
+                        exec(s.right);
+                    break;
+                case n_while:
+                    while (eval_cond(s.left) && !failed)
+                        exec(s.right);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+
+public:
+    interpreter(const ast& tree, std::istream& in, std::ostream& out)
+        : tree(tree), in(in), out(out),
+          ints(tree.vars.size()), reals(tree.vars.size()) {}
+
+    bool run()
+    {
+        exec(tree.root);
+        if (failed)
+            out << "error: division by zero\n";
+        return !failed;
+    }
+};
+
+} // namespace
+
+bool run(const ast& tree, std::istream& in, std::ostream& out)
+{
+    return interpreter(tree, in, out).run();
+}
+
+} // namespace calc
@@ -0,0 +1,866 @@
+/* Complete recursive descent parser for the calculator language.
+   Builds on figure 2.16 in the text.  Reports syntax errors and
+   recovers from them with Wirth's algorithm.  With a tracing policy
+   (see trace.hpp) it records the productions it predicts and the
+   tokens it matches.
+   Michael L. Scott, 2008-2022.
+*/
+
+#ifndef PARSE_HPP
+#define PARSE_HPP
+
+#include <iostream>
+#include <tuple>
+#include <list>
+#include <map>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include "scan.hpp"
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+using std::tuple;
+using std::vector;
+using std::tie;
+using std::map;
+using std::list;
+using std::unordered_map;
+using std::initializer_list;
+
+namespace calc {
+
+/*
+    several things to do today:
+    1. write the contain function
+    2. write the function for all parse steps
+    3. error check functions
+    4. 
+*/
+// enum token {t_read, t_write, t_id, t_gets, t_add, t_sub, t_mul, t_div, t_lparen, t_rparen, t_if, t_then, t_end, t_while, t_do, t_inum, t_rnum, t_neq, t_lt, t_gt, t_le, t_ge, t_trunc, t_real, t_int, t_float, t_semi, t_eof};
+const char* const names[] = {"read", "write", "id", "gets", "add", 
+                       "sub", "mul", "div", "lparen", "rparen", "if", "then", 
+                       "end", "while", "do", "inum", "rnum", "==", "<>", "<", ">", 
+                       "<=", ">=", "trunc", "real", "int", "float", "semi", "eof"};
+
+inline string op_image (token op) {
+    switch (op) {
+        case t_add: return "+";
+        case t_sub: return "-";
+        case t_mul: return "*";
+        case t_div: return "/";
+        case t_eq: case t_neq: case t_lt:
+        case t_gt: case t_le: case t_ge: return names[op];
+        default: return "";
+    }
+}
+
+// Variable index given to builders for a name that was never declared.
+const uint32_t no_var = UINT32_MAX;
+
+/*
+    Tree-building policies for the parser.  The parsing routines only
+    recognize the input; every piece of tree they grow goes through one
+    of these.  text_tree grows the linear, parenthesized syntax tree as
+    a string.  no_tree builds nothing at all, so parser<no_tree> (the
+    --check mode) just recognizes the input and reports errors.
+    Type and operator arguments are t_eof when they are missing.  The
+    parser numbers variables as it declares them; every declaration and
+    use of a name comes with its variable index (or no_var).  stmt_at
+    is told where each statement (including an empty one) starts, and
+    stmt_list gets a list's statements all at once, in order.
+    The tree is built through syntax errors too: missing stands for an
+    expression or condition that is not there (or a declaration or read
+    without a name, which binds nothing), and error wraps what was
+    built of a statement in which errors were found (or nothing, for
+    input skipped between statements).
+*/
+struct text_tree {
+    typedef string node;
+    typedef string symbol;
+
+    symbol intern (const string& image) { return image; }
+    void stmt_at (src_offset) {}
+    node empty () { return ""; }
+    node program (const node& sl) { return "[ " + sl + " ]"; }
+    node stmt_list (const vector<node>& stmts) {
+        size_t size = 0;
+        for (const node& s : stmts)
+            size += s.size();
+        node list;
+        list.reserve(size);
+        for (const node& s : stmts)
+            list += s;
+        return list;
+    }
+    node decl (token type, const symbol& id, uint32_t, const node& e) {
+        return "(" + string(names[type]) + " \"" + id + "\")\n"
+             + "(:= \"" + id + "\"" + e + ")\n";
+    }
+    node assign (const symbol& id, uint32_t, const node& e) {
+        return "(:= \"" + id + "\"" + e + ")";
+    }
+    node read (token type, const symbol& id, uint32_t) {
+        node current_str = "";
+        if (type != t_eof)
+            current_str = "(" + string(names[type]) + " \"" + id + "\")\n";
+        return current_str + "(read \"" + id + "\")\n";
+    }
+    node write (const node& e) { return "(write" + e + ")"; }
+    node if_stmt (const node& c, const node& sl) {
+        return "(if (" + c + ")\n[" + sl + "\n ])";
+    }
+    node while_stmt (const node& c, const node& sl) {
+        return "(while (" + c + ")\n[ " + sl + "\n ])";
+    }
+    node cond (token op, const node& l, const node& r) {
+        return (op == t_eof ? "(missing)" : op_image(op)) + l + r;
+    }
+    node binop (token op, const node& l, const node& r) {
+        return " (" + op_image(op) + l + r + ")";
+    }
+    node convert (token conv, const node& e) {
+        return " (" + string(names[conv]) + e + ")";
+    }
+    node leaf (token, const string& image, uint32_t) { return " \"" + image + "\""; }
+    node missing () { return " (missing)"; }
+    node error (const node& partial) {
+        if (partial.empty())
+            return "(error)";
+        return (partial[0] == ' ' ? "(error" : "(error ") + partial + ")";
+    }
+};
+
+struct no_tree {
+    struct node {};
+    struct symbol {};
+
+    symbol intern (const string&) { return {}; }
+    void stmt_at (src_offset) {}
+    node empty () { return {}; }
+    node program (node) { return {}; }
+    node stmt_list (const vector<node>&) { return {}; }
+    node decl (token, symbol, uint32_t, node) { return {}; }
+    node assign (symbol, uint32_t, node) { return {}; }
+    node read (token, symbol, uint32_t) { return {}; }
+    node write (node) { return {}; }
+    node if_stmt (node, node) { return {}; }
+    node while_stmt (node, node) { return {}; }
+    node cond (token, node, node) { return {}; }
+    node binop (token, node, node) { return {}; }
+    node convert (token, node) { return {}; }
+    node leaf (token, const string&, uint32_t) { return {}; }
+    node missing () { return {}; }
+    node error (node) { return {}; }
+};
+
+template <class Tree, class Trace = no_trace>
+class parser {
+    typedef typename Tree::node node;
+    typedef typename Tree::symbol symbol;
+
+    // What the expression routines return: the tree and its type, which
+    // is t_int, t_real, or t_eof when an error left it unknown.
+    struct typed {
+        node tree;
+        token type;
+    };
+
+    struct binding {
+        uint32_t var;
+        token type;
+    };
+
+    token next_token;
+    string token_image;
+    src_offset token_offset;
+    basic_scanner<Trace> s;
+    Tree tree;
+    map<string, bool> whether_epsilon;
+    map<string, list<token>> FIRST;
+    map<string, list<token>> FOLLOW;
+    map<string, byte_set> SYNC; // bytes that can start a member of FIRST or FOLLOW
+    unsigned unclaimed = 0;     // syntax errors not yet inside an error node
+
+    // Type checking is done as we parse.  if and while bodies are scopes;
+    // a declaration hides earlier ones of the same name until its scope ends.
+    unordered_map<string, vector<binding>> bindings;   // visible declarations, innermost last
+    vector<vector<binding>*> declared;                  // in order, to unbind at scope exit
+    uint32_t variables = 0;
+
+
+    // We need to report the error instead of exist the program
+    void error (string sym) {
+        s.report(token_offset, "found syntax error at " + sym + " for the current token " + token_image);
+        unclaimed++;
+    }
+
+    void type_error (src_offset at, const string& message) {
+        s.report(at, "type error: " + message);
+    }
+
+    uint32_t declare (const string& name, token type) {
+        vector<binding>& visible = bindings[name];
+        visible.push_back(binding{variables, type});
+        declared.push_back(&visible);
+        return variables++;
+    }
+
+    binding lookup (const string& name, src_offset at) {
+        auto found = bindings.find(name);
+        if (found == bindings.end() || found->second.empty()) {
+            type_error(at, "undeclared variable " + name);
+            return binding{no_var, t_eof};
+        }
+        return found->second.back();
+    }
+
+    void close_scope (size_t mark) {
+        for (; declared.size() > mark; declared.pop_back())
+            declared.back()->pop_back();
+    }
+
+    // int and real never mix; conversions must be explicit
+    token mix (token op, token l, token r, src_offset at) {
+        if (l == t_eof || r == t_eof)
+            return t_eof;
+        if (l != r) {
+            type_error(at, string("cannot mix ") + names[l] + " and " + names[r] + " in " + op_image(op));
+            return t_eof;
+        }
+        return l;
+    }
+
+    void check_store (token var_type, token value_type, const string& name, src_offset at) {
+        if (var_type != t_eof && value_type != t_eof && var_type != value_type)
+            type_error(at, string("cannot store ") + names[value_type] + " value in "
+                           + names[var_type] + " variable " + name);
+    }
+
+
+    void predict (production p) {
+        s.trace().predict(p, next_token, token_offset);
+    }
+
+    void advance () {
+        tie(next_token, token_image) = s.scan ();
+        token_offset = s.offset ();
+    }
+
+    template <class T, class I >
+    bool contains(const std::list<T>& list, const I & val){
+        return std::find(list.begin(), list.end(), val) != list.end();
+    }
+
+    void match (token expected) {
+        if (next_token == expected) {
+            s.trace().match(next_token, token_offset);
+            advance (); // if matched, scan next token
+        }
+        else{
+            error ("match");
+        }
+    }
+
+public:
+
+    void build_eps(){ // use bool for epsilon checking
+        whether_epsilon.insert({"P", false});
+        whether_epsilon.insert({"SL", true});
+        whether_epsilon.insert({"S", false});
+        whether_epsilon.insert({"E", false});
+        whether_epsilon.insert({"T", false});
+        whether_epsilon.insert({"F", false});
+        whether_epsilon.insert({"C", false});
+        whether_epsilon.insert({"TP", true});
+        whether_epsilon.insert({"TT", true});
+        whether_epsilon.insert({"FT", true});
+        whether_epsilon.insert({"RO", false});
+        whether_epsilon.insert({"AO", false});
+        whether_epsilon.insert({"MO", false});
+    }
+
+    void build_first(){
+        FIRST.insert({"SL", {t_int, t_real, t_id, t_read, t_write, t_if, t_while}});
+        FIRST.insert({"S", {t_int, t_real, t_id, t_read, t_write, t_if, t_while}});
+        FIRST.insert({"TP", {t_int, t_real}});
+        FIRST.insert({"TT", {t_add, t_sub}});
+        FIRST.insert({"FT", {t_mul, t_div}});
+        FIRST.insert({"F", {t_lparen, t_id, t_inum, t_rnum, t_trunc, t_float}});
+        FIRST.insert({"RO", {t_eq, t_neq, t_lt, t_gt, t_le, t_gt}});
+        FIRST.insert({"AO", {t_add, t_sub}});
+        FIRST.insert({"MO", {t_mul, t_div}});
+        FIRST.insert({"T", {t_lparen, t_id, t_inum, t_rnum, t_trunc, t_float}});
+        FIRST.insert({"P", {t_int, t_real, t_id, t_read, t_write, t_if, t_while, t_eof}});
+        FIRST.insert({"E", {t_lparen, t_id, t_inum, t_rnum, t_trunc, t_float}});
+        FIRST.insert({"C", {t_lparen, t_id, t_inum, t_rnum, t_trunc, t_float}});
+    }
+
+    void build_follow(){
+        FOLLOW.insert({"P", {t_eof}});
+        FOLLOW.insert({"SL",  {t_end, t_eof}});
+        FOLLOW.insert({"S",  {t_semi}});
+        FOLLOW.insert({"TP",  {t_id}});
+        FOLLOW.insert({"C",  {t_then, t_do}});
+
+        FOLLOW.insert({"E",  {t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi}});
+        
+        // = FOLLOW(E)
+        FOLLOW.insert({"TT",  {t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi}});
+
+        // FIRST(TT) - epsilon union FOLLOW(TT)
+        FOLLOW.insert({"T",  {t_add, t_sub, t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi}});
+
+        // = FOLLOW(T)
+        FOLLOW.insert({"FT",  {t_add, t_sub, t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi}});
+
+        // FIRST(FT) - epsilon union FOLLOW(FT)
+        FOLLOW.insert({"F",  {t_mul, t_div, t_add, t_sub, t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi}});
+
+        // = FIRST of (E)
+        FOLLOW.insert({"RO",  {t_lparen, t_id, t_inum, t_rnum, t_trunc, t_float}});
+
+        // = FIRST(T)
+        FOLLOW.insert({"AO",  {t_lparen, t_id, t_inum, t_rnum, t_trunc, t_float}});
+
+        // = FIRST(F)
+        FOLLOW.insert({"MO",  {t_lparen, t_id, t_inum, t_rnum, t_trunc, t_float}});
+    }
+
+    // Filled in on first use: only needed once there is an error.
+    const byte_set& sync_bytes(const string& sym)
+    {
+        auto found = SYNC.find(sym);
+        if (found != SYNC.end())
+            return found->second;
+        byte_set& bytes = SYNC[sym];
+        for (token t : FIRST[sym])
+            scanner::token_starts(t, bytes);
+        for (token t : FOLLOW[sym])
+            scanner::token_starts(t, bytes);
+        return bytes;
+    }
+
+    //Implementation of Wirths algorithm
+    void check_for_error(const string& sym)
+    {
+        // references, not copies: this runs at the top of every routine
+        bool eps = whether_epsilon[sym];
+        const list<token>& first = FIRST[sym];
+        const list<token>& follow = FOLLOW[sym];
+
+        if (!(contains(first, next_token) || (contains(follow, next_token) && eps))) // immediate error detection
+        {
+            error(sym);
+            const byte_set& sync = sync_bytes(sym);
+            do{
+                s.skip_to(sync); // only bytes that could start a token we want get scanned
+                advance();
+            }
+            while(!(contains(first, next_token) ||
+                    contains(follow, next_token) ||
+                    next_token == t_eof));
+        }
+    }
+
+    parser(std::istream& in = std::cin, diagnostic_handler report = print_diagnostic)
+        : s(in, report) {
+        advance ();
+    }
+
+    // Parse [begin, end) in place.
+    parser(const char* begin, const char* end, diagnostic_handler report = print_diagnostic)
+        : s(begin, end, report) {
+        advance ();
+    }
+
+    // Lexical, syntax or type errors: everything reported so far.
+    bool has_errors () const {
+        return s.errors() > 0;
+    }
+
+    Tree& get_tree () {
+        return tree;
+    }
+
+    const line_index& lines () const {
+        return s.line_starts();
+    }
+
+    Trace& trace () {
+        return s.trace();
+    }
+
+    node program () {
+        node current = tree.empty();
+        check_for_error("P");
+        switch (next_token) {
+            case t_int:
+            case t_real:
+            case t_id:
+            case t_read:
+            case t_write:
+            case t_if:
+            case t_while:
+            case t_eof:
+                predict(p_program);
+                current = tree.program(stmt_list(true));
+                match (t_eof);
+                break;
+            default: error("P");
+        }
+        return current;
+    }
+
+private:
+    // A statement with syntax errors in it, including input skipped
+    // just before it, is wrapped in an error node.  In the outermost
+    // list an end closes nothing; it is passed over as an error and
+    // the list goes on.
+    node stmt_list (bool outermost = false) {
+        unsigned outer = unclaimed;     // errors of the enclosing statement
+        vector<node> stmts;
+        for (;;) {
+            unclaimed = 0;
+            src_offset at = token_offset;
+            check_for_error("SL");
+            switch (next_token) {
+                case t_int:
+                case t_real:
+                case t_id:
+                case t_read:
+                case t_write:
+                case t_if:
+                case t_while: {
+                    predict(p_stmt_list);
+                    node s = stmt();
+                    match (t_semi);
+                    stmts.push_back(unclaimed > 0 ? tree.error(s) : s);
+                    continue;
+                }
+                case t_end:
+                    if (outermost) {
+                        error ("SL");
+                        match (t_end);
+                        if (next_token == t_semi)
+                            match (t_semi);
+                        tree.stmt_at(at);
+                        stmts.push_back(tree.error(tree.empty()));
+                        continue;
+                    }
+                    // fall through
+                case t_eof:
+                    predict(p_stmt_list_eps);
+                    break;      // epsilon production
+                default: error ("SL");
+            }
+            if (unclaimed > 0) {    // input skipped before the end of the list
+                tree.stmt_at(at);
+                stmts.push_back(tree.error(tree.empty()));
+            }
+            unclaimed = outer;
+            return tree.stmt_list(stmts);
+        }
+    }
+
+    node stmt () {
+        check_for_error("S");
+        tree.stmt_at(token_offset);
+        switch (next_token) {
+            case t_int:
+            case t_real: {
+                predict(p_stmt_decl);
+                token type = next_token;
+                match (type);
+                if (next_token != t_id) {       // no name to bind
+                    match (t_id);
+                    match (t_gets);
+                    expr();
+                    return tree.missing();
+                }
+                symbol id = tree.intern(token_image);
+                string name = token_image;
+                src_offset at = token_offset;
+                match (t_id);
+                match (t_gets);
+                typed e = expr();
+                check_store(type, e.type, name, at);
+                uint32_t var = declare(name, type);     // not visible in its own initializer
+                return tree.decl(type, id, var, e.tree);
+            }
+            case t_id: {
+                predict(p_stmt_assign);
+                symbol id = tree.intern(token_image);
+                string name = token_image;
+                binding b = lookup(name, token_offset);
+                src_offset at = token_offset;
+                match (t_id);
+                match (t_gets);
+                typed e = expr();
+                check_store(b.type, e.type, name, at);
+                return tree.assign(id, b.var, e.tree);
+            }
+            case t_read: {
+                predict(p_stmt_read);
+                match (t_read);
+                token type = TP();
+                if (next_token != t_id) {
+                    match (t_id);
+                    return tree.missing();
+                }
+                symbol id = tree.intern(token_image);
+                uint32_t var = type == t_eof ? lookup(token_image, token_offset).var
+                                             : declare(token_image, type);
+                match (t_id);
+                return tree.read(type, id, var);
+            }
+            case t_write:
+                predict(p_stmt_write);
+                match (t_write);
+                return tree.write(expr ().tree);
+            case t_if: {
+                predict(p_stmt_if);
+                match (t_if);
+                node c = C();
+                match (t_then);
+                size_t scope = declared.size();
+                node body = stmt_list();
+                close_scope(scope);
+                match (t_end);
+                return tree.if_stmt(c, body);
+            }
+            case t_while: {
+                predict(p_stmt_while);
+                match (t_while);
+                node c = C();
+                match (t_do);
+                size_t scope = declared.size();
+                node body = stmt_list();
+                close_scope(scope);
+                match (t_end);
+                return tree.while_stmt(c, body);
+            }
+            case t_semi:
+                predict(p_stmt_eps);
+                break;          // epsilon production
+            default: error ("S");
+        }
+        return tree.empty();
+    }
+
+    typed expr () {
+        check_for_error("E");
+        switch (next_token) {
+            case t_id:
+            case t_inum:
+            case t_rnum:
+            case t_lparen:
+            case t_trunc:
+            case t_float:
+                predict(p_expr);
+                return term_tail (term());
+            // t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi
+            case t_rparen:
+            case t_eq:
+            case t_neq:
+            case t_lt:
+            case t_gt:
+            case t_le:
+            case t_ge:
+            case t_then:
+            case t_do:
+            case t_semi:
+            case t_eof:
+                predict(p_expr_eps);
+                break;          // epsilon production
+            default: error ("E");
+        }
+        return typed{tree.missing(), t_eof};
+    }
+
+    typed term_tail (typed lhs) { // lhs from term, left-associative
+        // t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_gt, t_then, t_do, t_semi
+        check_for_error("TT");
+        switch (next_token) {
+            case t_add:
+            case t_sub: {
+                predict(p_term_tail);
+                src_offset at = token_offset;
+                token op = add_op();
+                typed rhs = term();
+                return term_tail(typed{tree.binop(op, lhs.tree, rhs.tree),
+                                       mix(op, lhs.type, rhs.type, at)});
+            }
+            case t_rparen:
+            case t_eq:
+            case t_neq:
+            case t_lt:
+            case t_gt:
+            case t_le:
+            case t_ge:
+            case t_then:
+            case t_do:
+            case t_semi:
+            case t_eof:
+                predict(p_term_tail_eps);
+                return lhs;          // epsilon production
+            default: error ("TT");
+        }
+        return typed{tree.missing(), t_eof};
+    }
+
+    typed term () {
+        check_for_error("T");
+        switch (next_token) {
+            case t_id:
+            case t_inum:
+            case t_rnum:
+            case t_lparen:
+            case t_trunc:
+            case t_float:
+                predict(p_term);
+                return factor_tail (factor ());
+            // t_add, t_sub, t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi
+            case t_add:
+            case t_sub:
+            case t_rparen:
+            case t_eq:
+            case t_neq:
+            case t_lt:
+            case t_gt:
+            case t_le:
+            case t_ge:
+            case t_then:
+            case t_do:
+            case t_semi:
+            case t_eof:
+                predict(p_term_eps);
+                break;          // epsilon production
+            default: error ("T");
+        }
+        return typed{tree.missing(), t_eof};
+    }
+
+    typed factor_tail (typed lhs) { // lhs from factor, left-associative
+        check_for_error("FT");
+        switch (next_token) {
+            case t_mul:
+            case t_div: {
+                predict(p_factor_tail);
+                src_offset at = token_offset;
+                token op = mul_op();
+                typed rhs = factor();
+                return factor_tail(typed{tree.binop(op, lhs.tree, rhs.tree),
+                                         mix(op, lhs.type, rhs.type, at)});
+            }
+            // t_add, t_sub, t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi
+            case t_add:
+            case t_sub:
+            case t_rparen:
+            case t_eq:
+            case t_neq:
+            case t_lt:
+            case t_gt:
+            case t_le:
+            case t_ge:
+            case t_then:
+            case t_do:
+            case t_semi:
+            case t_eof:
+                predict(p_factor_tail_eps);
+                return lhs;          // epsilon production
+            default: error ("FT");
+        }
+        return typed{tree.missing(), t_eof};
+    }
+
+    typed factor () {
+        check_for_error("F");
+        switch (next_token) {
+            case t_inum:
+            case t_rnum:
+            case t_id : {
+                predict(p_factor_leaf);
+                token kind = next_token;
+                binding b = {no_var, kind == t_inum ? t_int : t_real};
+                if (kind == t_id)
+                    b = lookup(token_image, token_offset);
+                node leaf = tree.leaf(kind, token_image, b.var);
+                match (kind);
+                return typed{leaf, b.type};
+            }
+            case t_lparen: {
+                predict(p_factor_paren);
+                match (t_lparen);
+                typed e = expr ();
+                match (t_rparen);
+                return e;
+            }
+            case t_trunc:
+            case t_float: {
+                predict(p_factor_convert);
+                token conv = next_token;
+                token from = conv == t_trunc ? t_real : t_int;
+                src_offset at = token_offset;
+                match (conv);
+                match (t_lparen);
+                typed e = expr ();
+                match (t_rparen);
+                if (e.type != t_eof && e.type != from)
+                    type_error(at, string(names[conv]) + " applied to " + names[e.type] + " value");
+                return typed{tree.convert(conv, e.tree), conv == t_trunc ? t_int : t_real};
+            }
+            // t_mul, t_div, t_add, t_sub, t_rparen, t_eq, t_neq, t_lt, t_gt, t_le, t_ge, t_then, t_do, t_semi
+            case t_mul:
+            case t_div:
+            case t_add:
+            case t_sub:
+            case t_rparen:
+            case t_eq:
+            case t_neq:
+            case t_lt:
+            case t_gt:
+            case t_le:
+            case t_ge:
+            case t_then:
+            case t_do:
+            case t_semi:
+            case t_eof:
+                predict(p_factor_eps);
+                break;          // epsilon production
+            default: error ("F");
+        }
+        return typed{tree.missing(), t_eof};
+    }
+
+    token add_op () {
+        check_for_error("AO");
+        switch (next_token) {
+            case t_add:
+            case t_sub: {
+                predict(p_add_op);
+                token op = next_token;
+                match (op);
+                return op;
+            }
+            // t_lparen, t_id, t_inum, t_rnum
+            case t_lparen:
+            case t_id:
+            case t_inum:
+            case t_rnum:
+            case t_trunc:
+            case t_float:
+                predict(p_add_op_eps);
+                break;          // epsilon production
+            default: error ("AO");
+        }
+        return t_eof;
+    }
+
+    token mul_op () {
+        check_for_error("MO");
+        switch (next_token) {
+            case t_mul:
+            case t_div: {
+                predict(p_mul_op);
+                token op = next_token;
+                match (op);
+                return op;
+            }
+            // t_lparen, t_id, t_inum, t_rnum
+            case t_lparen:
+            case t_id:
+            case t_inum:
+            case t_rnum:
+            case t_trunc:
+            case t_float:
+                predict(p_mul_op_eps);
+                break;          // epsilon production
+            default: error ("MO");
+        }
+        return t_eof;
+    }
+
+    node C(){
+        check_for_error("C");
+        switch (next_token) {
+            case t_id:
+            case t_inum:
+            case t_rnum:
+            case t_lparen:
+            case t_trunc:
+            case t_float: {
+                predict(p_cond);
+                typed lhs = expr();
+                src_offset at = token_offset;
+                token op = RO();
+                typed rhs = expr();
+                mix(op, lhs.type, rhs.type, at);
+                return tree.cond(op, lhs.tree, rhs.tree);
+            }
+            // t_then, t_do
+            case t_then:
+            case t_do:
+            case t_eof:
+                predict(p_cond_eps);
+                break;          // epsilon production
+            default: error ("C");
+        }
+        return tree.missing();
+    }
+
+    token TP(){ // t_eof when the type is left out
+        check_for_error("TP");
+        switch (next_token) {
+            case t_int:
+            case t_real: {
+                predict(p_type);
+                token type = next_token;
+                match(type);
+                return type;
+            }
+            // t_id
+            case t_id:
+            case t_eof:
+                predict(p_type_eps);
+                break;          // epsilon production
+            default: error ("TP");
+        }
+        return t_eof;
+    }
+
+    token RO(){
+        check_for_error("RO");
+        switch (next_token) {
+            case t_eq:
+            case t_neq:
+            case t_lt:
+            case t_gt:
+            case t_le:
+            case t_ge: {
+                predict(p_relop);
+                token op = next_token;
+                match (op);
+                return op;
+            }
+            // t_lparen, t_id, t_inum, t_rnum
+            case t_lparen:
+            case t_id:
+            case t_inum:
+            case t_rnum:
+            case t_trunc:
+            case t_float:
+            case t_eof:
+                predict(p_relop_eps);
+                break;          // epsilon production
+            default: error ("RO");
+        }
+        return t_eof;
+    }
+
+};
+
+} // namespace calc
+
+#endif
@@ -0,0 +1,78 @@
+#!/bin/bash
+# Regression checks: each one feeds a program to ./parse and compares
+# all that it prints with what it should print.
+# Usage: ./regress.sh        (after make)
+
+failed=0
+
+# check NAME EXPECTED [parse options] < input
+check() {
+    local name=$1 expected=$2
+    shift 2
+    local actual
+    actual=$(./parse "$@" 2>&1)
+    if [ "$actual" == "$expected" ]; then
+        echo "ok      $name"
+    else
+        echo "FAILED  $name"
+        diff <(echo "$expected") <(echo "$actual")
+        failed=1
+    fi
+}
+
+# Recovery must not start scanning in the middle of :=
+check "skip stops before :=" \
+'found syntax error at FT for the current token 2 on line 2, column 9
+[ (int "x")
+(:= "x" "0")
+(error (write "1"))(write "x") ]' <<'END'
+int x := 0;
+write 1 2 y := 3;
+write x;
+END
+
+# A long run of bytes that cannot start a token is one error, skipped
+# at once (this used to overflow the stack)
+check "two million bad bytes" \
+'type error: undeclared variable x on line 1, column 7
+unexpected character '"'\$'"' (0x24); skipped 2000001 bytes on line 2, column 1
+[ (write "x")(write "2") ]' < <(echo 'write x;'; head -c 2000000 /dev/zero | tr '\0' '$'; echo; echo 'write 2;')
+
+# A declaration without a name binds nothing (not a variable named :=)
+check "declaration without a name" \
+'found syntax error at match for the current token := on line 1, column 5
+[ (error (missing))(write "4") ]' <<< 'int := 3; write 4;'
+
+# A missing relational operator shows in the tree
+check "condition without an operator" \
+'found syntax error at RO for the current token then on line 1, column 18
+found syntax error at match for the current token ; on line 1, column 30
+found syntax error at SL for the current token ; on line 1, column 30
+[ (int "x")
+(:= "x" "0")
+(error (if ((missing) "x" "1")
+[(error)
+ ])) ]' <<< 'int x := 0; if x then write 1; end;'
+
+# A stray end at the top level is skipped and parsing goes on
+check "stray end" \
+'found syntax error at SL for the current token end on line 1, column 10
+[ (write "1")(error)(write "2") ]' <<< 'write 1; end; write 2;'
+
+# The sign of an exponent is inside the number, not a new token
+check "skip stops after 1e-3" \
+'found syntax error at FT for the current token b on line 2, column 9
+[ (int "a")
+(:= "a" "1")
+(error (write "a"))(write "a") ]' <<'END'
+int a := 1;
+write a b 1e-3;
+write a;
+END
+
+# --run reports an int division by zero instead of trapping
+check "run divides by zero" \
+'1
+error: division by zero' --run <(printf 'read int a;\nwrite 1;\nwrite 10 / a;\nwrite 2;\n') <<< 0
+
+exit $failed
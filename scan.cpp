@@ -1,204 +1,420 @@
 /* Simple ad-hoc scanner for the calculator language.
-   Dies on lexical errors.
+   Reports lexical errors and skips the bad input.
    Michael L. Scott, 2008-2022.
 */
 
 #include <iostream>
 #include <cctype>   // isalpha, isspace, isdigit
 #include <tuple>
+#include <algorithm>
+#include <sstream>
+#include <cstring>  // memchr
 using std::cerr;
 using std::cin;
 using std::cout;
 using std::hex;
+using std::dec;
 using std::endl;
 using std::string;
+using std::tuple;
 using std::make_tuple;
+using std::upper_bound;
+using std::ostringstream;
 
 #include "scan.hpp"
 
-tuple<token, string> scanner::scan() {
-    string token_image;
+namespace calc {
 
-    // skip white space
-    while (isspace(c)) {
-        c = cin.get();
+template <class Trace>
+bool basic_scanner<Trace>::refill() {
+    if (!in)
+        return false;
+    if (buffer.empty())
+        buffer.resize(1 << 16);
+    in->read(buffer.data(), buffer.size());
+    next = buffer.data();
+    last = next + in->gcount();
+    return next < last;
+}
+
+// Every character goes through here so the scanner always knows its
+// byte offset in the input and where each line starts.
+template <class Trace>
+int basic_scanner<Trace>::next_char() {
+    if (next == last && !refill())
+        return EOF;
+    int ch = (unsigned char) *next++;
+    consumed++;
+    if (ch == '\n')
+        lines.add(consumed);
+    return ch;
+}
+
+static bool word_char(int ch) {
+    return isalnum(ch) || ch == '_';
+}
+
+// Follows the bytes error recovery passes over, to tell whether the
+// next one is inside a token that began earlier: a word, a number (the
+// sign of an exponent, as in 1e-3, included), or the second byte of
+// := <= >= <> or ==.  Recovery must not start scanning there.
+class token_run {
+    enum { none, name, number } word;
+    int prev;
+
+public:
+    explicit token_run(int ch) : word(none), prev(EOF) { continues(ch); }
+
+    // Bytes that are never inside a token begun before them, and after
+    // which none is: passing over them is all the same to continues.
+    static const byte_set& breaks() {
+        static const byte_set bytes = [] {
+            byte_set all;
+            for (int ch = 1; ch < 256; ch++)
+                all[ch] = !word_char(ch) && !strchr(".+-:<>=", ch);
+            all[0] = true;
+            return all;
+        }();
+        return bytes;
     }
-    if (c == EOF)
-        return make_tuple(t_eof, "eof");
-    if (isalpha(c)) { 
-        do { // variable name
-            token_image += c;
-            c = cin.get();
-        } while (isalpha(c) || isdigit(c) || c == '_');
-        if (token_image == "read") return make_tuple(t_read, "read");
-        else if (token_image == "write") return make_tuple(t_write, "write");
-        else if (token_image == "trunc") return make_tuple(t_trunc, "trunc");
-        else if (token_image == "float") return make_tuple(t_float, "float");
-        else if (token_image == "while") return make_tuple(t_while, "while");
-        else if (token_image == "int") return make_tuple(t_int, "int");
-        else if (token_image == "i_num") return make_tuple(t_inum, "i_num");
-        else if (token_image == "r_num") return make_tuple(t_rnum, "r_num");
-        else if (token_image == "real") return make_tuple(t_real, "real");
-        else if (token_image == "do") return make_tuple(t_do, "do");
-        else if (token_image == "end") return make_tuple(t_end, "end");
-        else if (token_image == "then") return make_tuple(t_then, "then");
-        else if (token_image == "if") return make_tuple(t_if, "if");
-        else return make_tuple(t_id, token_image);
+
+    void pass_break() { word = none; prev = ' '; }
+
+    bool continues(int ch) {
+        bool inside;
+        if (word_char(ch) || ch == '.') {
+            inside = word != none;
+            if (!inside)
+                word = isdigit(ch) || ch == '.' ? number : name;
+        }
+        else if ((ch == '+' || ch == '-') && prev == 'e' && word == number)
+            inside = true;      // the number goes on
+        else {
+            word = none;
+            if (ch == '=')
+                inside = prev == ':' || prev == '<' || prev == '>' || prev == '=';
+            else
+                inside = ch == '>' && prev == '<';
+        }
+        prev = ch;
+        return inside;
     }
+};
 
-    // i_num  =  d+
-    // r_num  =  ( d+ . d* | d* . d+ ) ( e ( + | - | ε ) d+ | ε )
-    else if (isdigit(c)){
-        do { // d+ . d*
-            token_image += c;
-            c = cin.get();
-        } while (isdigit(c));
-        if (c == '.') { 
-            token_image += c;
-            c = cin.get();
-            if (isdigit(c)) {
-                do {
-                    token_image += c;
-                    c = cin.get();
-                } while (isdigit(c));
-                if (c == 'e') { // ( e ( + | - | ε ) d+ | ε )
-                    token_image += c;
-                    c = cin.get();
-                    if (c == '+' || c == '-') {
+template <class Trace>
+void basic_scanner<Trace>::skip_to(const byte_set& starts) {
+    if (c == EOF || starts[c])      // c always begins a token
+        return;
+    token_run run(c);
+    byte_set quiet = token_run::breaks() & ~starts;     // passed over without a look
+    while (next < last || refill()) {
+        const char* p = next;
+        while (p < last) {
+            const char* q = p;
+            while (q < last && quiet[(unsigned char) *q])
+                q++;
+            if (q != p)
+                run.pass_break();
+            if ((p = q) == last)
+                break;
+            unsigned char ch = *p;
+            if (!run.continues(ch) && starts[ch])
+                break;
+            p++;
+        }
+        // account for the bytes passed over, newlines included
+        for (const char* nl = next; (nl = (const char*) memchr(nl, '\n', p - nl)); nl++)
+            lines.add(consumed + (nl - next) + 1);
+        consumed += p - next;
+        next = p;
+        if (p < last) {
+            c = next_char();
+            trace_log.skip(consumed - 1);
+            return;
+        }
+    }
+    c = EOF;
+    trace_log.skip(consumed);
+}
+
+template <class Trace>
+void basic_scanner<Trace>::token_starts(token t, byte_set& bytes) {
+    const char* first;
+    switch (t) {
+        case t_id:
+            for (int ch = 0; ch < 256; ch++)
+                if (isalpha(ch))
+                    bytes.set(ch);
+            return;
+        case t_inum: first = "0123456789i"; break;     // i_num
+        case t_rnum: first = "0123456789.r"; break;    // r_num
+        case t_read: case t_real: first = "r"; break;
+        case t_write: case t_while: first = "w"; break;
+        case t_if: case t_int: first = "i"; break;
+        case t_then: case t_trunc: first = "t"; break;
+        case t_end: first = "e"; break;
+        case t_do: first = "d"; break;
+        case t_float: first = "f"; break;
+        case t_gets: first = ":"; break;
+        case t_add: first = "+"; break;
+        case t_sub: first = "-"; break;
+        case t_mul: first = "*"; break;
+        case t_div: first = "/"; break;
+        case t_lparen: first = "("; break;
+        case t_rparen: first = ")"; break;
+        case t_eq: first = "="; break;
+        case t_neq: case t_lt: case t_le: first = "<"; break;
+        case t_gt: case t_ge: first = ">"; break;
+        case t_semi: first = ";"; break;
+        default: return;    // t_eof: end of input always stops a skip
+    }
+    for (; *first; first++)
+        bytes.set((unsigned char) *first);
+}
+
+// Every byte that can start a token.
+static const byte_set& token_bytes() {
+    static const byte_set bytes = [] {
+        byte_set all;
+        for (int t = t_read; t < t_eof; t++)
+            scanner::token_starts(token(t), all);
+        return all;
+    }();
+    return bytes;
+}
+
+// Resolve an offset to a line and column; only done for diagnostics.
+location line_index::locate(src_offset offset) const {
+    auto next_line = upper_bound(starts.begin(), starts.end(), offset);
+    unsigned line = next_line - starts.begin();
+    return location{line, offset - *(next_line - 1) + 1};
+}
+
+template <class Trace>
+void basic_scanner<Trace>::report(src_offset offset, const string& message) {
+    trace_log.error(offset);
+    reported++;
+    handler(diagnostic{offset, locate(offset), message});
+}
+
+void print_diagnostic(const diagnostic& d) {
+    cout << d.message << " on " << d.where << endl;
+}
+
+template <class Trace>
+tuple<token, string> basic_scanner<Trace>::scan() {
+    tuple<token, string> t = scan_token();
+    trace_log.scan(std::get<0>(t), start);
+    return t;
+}
+
+template <class Trace>
+tuple<token, string> basic_scanner<Trace>::scan_token() {
+    // a lexical error throws away the invalid token and goes on to the next
+    for (;;) {
+        string token_image;
+
+        // skip white space
+        while (isspace(c)) {
+            c = next_char();
+        }
+        start = c == EOF ? consumed : consumed - 1;
+        if (c == EOF)
+            return make_tuple(t_eof, "eof");
+        if (isalpha(c)) { 
+            do { // variable name
+                token_image += c;
+                c = next_char();
+            } while (isalpha(c) || isdigit(c) || c == '_');
+            if (token_image == "read") return make_tuple(t_read, "read");
+            else if (token_image == "write") return make_tuple(t_write, "write");
+            else if (token_image == "trunc") return make_tuple(t_trunc, "trunc");
+            else if (token_image == "float") return make_tuple(t_float, "float");
+            else if (token_image == "while") return make_tuple(t_while, "while");
+            else if (token_image == "int") return make_tuple(t_int, "int");
+            else if (token_image == "i_num") return make_tuple(t_inum, "i_num");
+            else if (token_image == "r_num") return make_tuple(t_rnum, "r_num");
+            else if (token_image == "real") return make_tuple(t_real, "real");
+            else if (token_image == "do") return make_tuple(t_do, "do");
+            else if (token_image == "end") return make_tuple(t_end, "end");
+            else if (token_image == "then") return make_tuple(t_then, "then");
+            else if (token_image == "if") return make_tuple(t_if, "if");
+            else return make_tuple(t_id, token_image);
+        }
+
+        // i_num  =  d+
+        // r_num  =  ( d+ . d* | d* . d+ ) ( e ( + | - | ε ) d+ | ε )
+        else if (isdigit(c)){
+            do { // d+ . d*
+                token_image += c;
+                c = next_char();
+            } while (isdigit(c));
+            if (c == '.') { 
+                token_image += c;
+                c = next_char();
+                if (isdigit(c)) {
+                    do {
                         token_image += c;
-                        c = cin.get();
-                    }
-                    if (isdigit(c)) {
-                        do {
+                        c = next_char();
+                    } while (isdigit(c));
+                    if (c == 'e') { // ( e ( + | - | ε ) d+ | ε )
+                        token_image += c;
+                        c = next_char();
+                        if (c == '+' || c == '-') {
                             token_image += c;
-                            c = cin.get();
-                        } while (isdigit(c));
-                        return make_tuple(t_rnum, token_image);
+                            c = next_char();
+                        }
+                        if (isdigit(c)) {
+                            do {
+                                token_image += c;
+                                c = next_char();
+                            } while (isdigit(c));
+                            return make_tuple(t_rnum, token_image);
+                        }
+                        else {
+                            report(start, "Error: invalid real number: " + token_image);
+                        }
                     }
                     else {
-                        cout << "Error: invalid real number: " << token_image << endl;
+                        return make_tuple(t_rnum, token_image);
                     }
                 }
                 else {
-                    return make_tuple(t_rnum, token_image);
+                    report(start, "Error: invalid real number: " + token_image);
                 }
             }
-            else {
-                cout << "Error: invalid real number: " << token_image << endl;
-            }
-        }
-        else if (c == 'e') {
-            token_image += c;
-            c = cin.get();
-            if (c == '+' || c == '-') {
+            else if (c == 'e') {
                 token_image += c;
-                c = cin.get();
-            }
-            if (isdigit(c)) {
-                do {
+                c = next_char();
+                if (c == '+' || c == '-') {
                     token_image += c;
-                    c = cin.get();
-                } while (isdigit(c));
-                return make_tuple(t_rnum, token_image);
+                    c = next_char();
+                }
+                if (isdigit(c)) {
+                    do {
+                        token_image += c;
+                        c = next_char();
+                    } while (isdigit(c));
+                    return make_tuple(t_rnum, token_image);
+                }
+                else {
+                    report(start, "Error: invalid real number: " + token_image);
+                }
             }
             else {
-                cout << "Error: invalid real number: " << token_image << endl;
+                return make_tuple(t_inum, token_image);
             }
         }
-        else {
-            return make_tuple(t_inum, token_image);
-        }
-    }
-    else if (c == '.') {// d* . d+
-            token_image += c;
-            c = cin.get();
-            if (isdigit(c)) {
-                do {
-                    token_image += c;
-                    c = cin.get();
-                } while (isdigit(c));
-                if (c == 'e') { // ( e ( + | - | ε ) d+ | ε )
-                    token_image += c;
-                    c = cin.get();
-                    if (c == '+' || c == '-') {
+        else if (c == '.') {// d* . d+
+                token_image += c;
+                c = next_char();
+                if (isdigit(c)) {
+                    do {
                         token_image += c;
-                        c = cin.get();
-                    }
-                    if (isdigit(c)) {
-                        do {
+                        c = next_char();
+                    } while (isdigit(c));
+                    if (c == 'e') { // ( e ( + | - | ε ) d+ | ε )
+                        token_image += c;
+                        c = next_char();
+                        if (c == '+' || c == '-') {
                             token_image += c;
-                            c = cin.get();
-                        } while (isdigit(c));
-                        return make_tuple(t_rnum, token_image);
+                            c = next_char();
+                        }
+                        if (isdigit(c)) {
+                            do {
+                                token_image += c;
+                                c = next_char();
+                            } while (isdigit(c));
+                            return make_tuple(t_rnum, token_image);
+                        }
+                        else {
+                            report(start, "Error: invalid real number: " + token_image);
+                        }
                     }
                     else {
-                        cout << "Error: invalid real number: " << token_image << endl;
+                        return make_tuple(t_rnum, token_image);
                     }
                 }
                 else {
-                    return make_tuple(t_rnum, token_image);
+                    report(start, "Error: invalid real number: " + token_image);
                 }
             }
-            else {
-                cout << "Error: invalid real number: " << token_image << endl;
+        else switch (c) {
+            case ':': 
+                c = next_char();
+                if (c != '=') {// must have '=' after ':'
+                    ostringstream message;
+                    message << "expected '=' after ':', got '"
+                            << c << "' (0x" << hex << c << ")";
+                    report(start, message.str());
+                    next_char();
+                } else {
+                    c = next_char();
+                    return make_tuple(t_gets, ":=");
+                }
+                break;
+            case '+': c = next_char(); return make_tuple(t_add, "+");
+            case '-': c = next_char(); return make_tuple(t_sub, "-");
+            case '*': c = next_char(); return make_tuple(t_mul, "*");
+            case '/': c = next_char(); return make_tuple(t_div, "/");
+            case '(': c = next_char(); return make_tuple(t_lparen, "(");
+            case ')': c = next_char(); return make_tuple(t_rparen, ")");
+            case '<': 
+                c = next_char();
+                if(c == '='){
+    				c = next_char();
+    				return make_tuple(t_le, "<=");
+    			}
+                else if(c == '>'){
+                    c = next_char();
+    				return make_tuple(t_neq, "<>");
+                }
+                else{
+    				return make_tuple(t_lt, "<");
+    			}
+            case '>':
+                c  = next_char();
+                if(c == '='){
+    				c = next_char();
+    				return make_tuple(t_ge, ">=");
+    			}
+                else{
+    				return make_tuple(t_gt, ">");
+                }
+            case '=':
+                c = next_char();
+                if (c != '=') { // must have '=' after '='
+                    ostringstream message;
+                    message << "expected '=' after '=', got '"
+                            << c << "' (0x" << hex << c << ")";
+                    report(start, message.str());
+                    c = next_char();
+                } else {
+                    c = next_char();
+                    return make_tuple(t_eq, "==");
+                }
+                break;
+            case ';':
+                c = next_char();
+                return make_tuple(t_semi, ";");
+            default: {
+                // everything up to the next byte that can start a token
+                // (white space included) is one error, passed over at
+                // skip_to speed
+                int first = c;
+                skip_to(token_bytes());
+                src_offset end = c == EOF ? consumed : consumed - 1;
+                ostringstream message;
+                message << "unexpected character '" << char(first) << "' (0x" << hex << first << ")";
+                if (end - start > 1)
+                    message << dec << "; skipped " << end - start << " bytes";
+                report(start, message.str());
             }
         }
-    else switch (c) {
-        case ':': 
-            c = cin.get();
-            if (c != '=') {// must have '=' after ':'
-                cout << "expected '=' after ':', got '"
-                     << c << "' (0x" << hex << c << ")\n";
-                cin.get();
-            } else {
-                c = cin.get();
-                return make_tuple(t_gets, ":=");
-            }
-            break;
-        case '+': c = cin.get(); return make_tuple(t_add, "+");
-        case '-': c = cin.get(); return make_tuple(t_sub, "-");
-        case '*': c = cin.get(); return make_tuple(t_mul, "*");
-        case '/': c = cin.get(); return make_tuple(t_div, "/");
-        case '(': c = cin.get(); return make_tuple(t_lparen, "(");
-        case ')': c = cin.get(); return make_tuple(t_rparen, ")");
-        case '<': 
-            c = cin.get();
-            if(c == '='){
-				c = cin.get();
-				return make_tuple(t_le, "<=");
-			}
-            else if(c == '>'){
-                c = cin.get();
-				return make_tuple(t_neq, "<>");
-            }
-            else{
-				return make_tuple(t_lt, "<");
-			}
-        case '>':
-            c  = cin.get();
-            if(c == '='){
-				c = std::cin.get();
-				return make_tuple(t_ge, ">=");
-			}
-            else{
-				return make_tuple(t_gt, ">");
-            }
-        case '=':
-            c = cin.get();
-            if (c != '=') { // must have '=' after '='
-                cout << "expected '=' after ':', got '"
-                     << c << "' (0x" << hex << c << ")\n";
-                c = cin.get();
-            } else {
-                c = cin.get();
-                return make_tuple(t_eq, "==");
-            }
-            break;
-        case ';':
-            c = cin.get();
-            return make_tuple(t_semi, ";");
-        default:
-            cout << "unexpected character '"  << c << "' (0x" << hex << c << ")\n";
-            c = cin.get();
     }
-} // scan
+} // scan_token
+
+template class basic_scanner<no_trace>;
+template class basic_scanner<ring_trace>;
+
+} // namespace calc
@@ -2,9 +2,19 @@
    Michael L. Scott, 2008-2022.
 */
 
+#ifndef SCAN_HPP
+#define SCAN_HPP
+
 #include <tuple>
-using std::string;
-using std::tuple;
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <functional>
+#include <bitset>
+#include "trace.hpp"
+
+namespace calc {
 
 enum token
 {
@@ -39,13 +49,98 @@ enum token
     t_eof
 };
 
-const int MAX_TOKEN_LEN = 256;
-extern char token_image[MAX_TOKEN_LEN];
+// Byte offset of a token in the input.  Tokens carry only this; it is
+// turned into a line and column when a diagnostic needs one.
+typedef uint32_t src_offset;
+
+struct location
+{
+    unsigned line;
+    unsigned column;
+};
+
+inline std::ostream& operator<<(std::ostream& os, const location& loc)
+{
+    return os << "line " << loc.line << ", column " << loc.column;
+}
 
-class scanner
+// Where each line of the input starts.  Kept after parsing so later
+// passes can place their diagnostics too.
+class line_index
 {
+    std::vector<src_offset> starts = {0};
+
+public:
+    void add(src_offset start) { starts.push_back(start); }
+    location locate(src_offset offset) const;
+};
+
+// A lexical or syntax error.  The scanner and parser never print; they
+// hand each one to a diagnostic_handler as soon as it is found.
+struct diagnostic
+{
+    src_offset offset;
+    location where;
+    std::string message;
+};
+
+typedef std::function<void(const diagnostic&)> diagnostic_handler;
+
+// A set of byte values, e.g. the bytes some set of tokens can start with.
+typedef std::bitset<256> byte_set;
+
+// The handler the parse command uses: prints to cout.
+void print_diagnostic(const diagnostic& d);
+
+// Trace is a tracing policy (see trace.hpp); the scanner records each
+// token it returns, each recovery skip, and each diagnostic.  Its
+// members are instantiated in scan.cpp for no_trace and ring_trace.
+template <class Trace>
+class basic_scanner
+{
+    std::istream* in;                        // null when scanning a span in place
+    diagnostic_handler handler;
+    std::vector<char> buffer;                // for in; allocated on first read
+    const char* next = nullptr;              // unread input is [next, last)
+    const char* last = nullptr;
     int c = ' ';
+    src_offset consumed = 0;                 // characters read so far
+    src_offset start = 0;                    // offset of the last token
+    unsigned reported = 0;                   // diagnostics so far
+    line_index lines;                        // where each line starts
+    Trace trace_log;
+
+    bool refill();
+    int next_char();
+    std::tuple<token, std::string> scan_token();
 
 public:
-    tuple<token, string> scan();
+    basic_scanner(std::istream& in = std::cin, diagnostic_handler handler = print_diagnostic)
+        : in(&in), handler(handler) {}
+    // Scan [begin, end) where it is, without copying it.
+    basic_scanner(const char* begin, const char* end, diagnostic_handler handler = print_diagnostic)
+        : in(nullptr), handler(handler), next(begin), last(end) {}
+    std::tuple<token, std::string> scan();
+    src_offset offset() const { return start; }
+    location locate(src_offset offset) const { return lines.locate(offset); }
+    const line_index& line_starts() const { return lines; }
+    void report(src_offset offset, const std::string& message);
+    unsigned errors() const { return reported; }
+
+    // Error recovery: throw away input, without building tokens, up to
+    // the next byte in starts that is not inside a word, a number (its
+    // exponent's sign included) or a two-byte operator.  The next scan()
+    // starts there.
+    void skip_to(const byte_set& starts);
+
+    // Add to bytes every byte a t token can start with.
+    static void token_starts(token t, byte_set& bytes);
+
+    Trace& trace() { return trace_log; }
 };
+
+typedef basic_scanner<no_trace> scanner;
+
+} // namespace calc
+
+#endif
@@ -0,0 +1,46 @@
+/* Trace files: written by ring_trace, read back by tracedump.
+*/
+
+#include <cstring>  // memcmp, memcpy
+#include "trace.hpp"
+
+namespace calc {
+
+static const char trace_magic[8] = {'c', 'a', 'l', 'c', 't', 'r', 'c', '1'};
+
+ring_trace::ring_trace (size_t capacity) {
+    size_t size = 1;
+    while (size < capacity)
+        size <<= 1;
+    ring.resize(size);
+    epoch = clock::now();
+}
+
+bool ring_trace::write (std::ostream& out) const {
+    uint64_t kept = total < ring.size() ? total : ring.size();
+    trace_header header;
+    memcpy(header.magic, trace_magic, sizeof header.magic);
+    header.total = total;
+    header.records = kept;
+    header.record_size = sizeof(trace_record);
+    out.write((const char*) &header, sizeof header);
+
+    // oldest first: the ring wraps at total mod size
+    size_t first = (total - kept) & (ring.size() - 1);
+    size_t tail = ring.size() - first < kept ? ring.size() - first : kept;
+    out.write((const char*) &ring[first], tail * sizeof(trace_record));
+    out.write((const char*) ring.data(), (kept - tail) * sizeof(trace_record));
+    return bool(out);
+}
+
+bool read_trace (std::istream& in, trace_header& header, std::vector<trace_record>& records) {
+    if (!in.read((char*) &header, sizeof header)
+            || memcmp(header.magic, trace_magic, sizeof trace_magic) != 0
+            || header.record_size != sizeof(trace_record))
+        return false;
+    records.resize(header.records);
+    in.read((char*) records.data(), records.size() * sizeof(trace_record));
+    return size_t(in.gcount()) == records.size() * sizeof(trace_record);
+}
+
+} // namespace calc
@@ -0,0 +1,165 @@
+/* Parse tracing.
+   The scanner and parser take a tracing policy as a template argument.
+   no_trace, the default, does nothing and compiles away.  ring_trace
+   keeps the most recent events as fixed-size binary records in a ring
+   buffer and can write them to a file; tracedump decodes the file.
+*/
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+namespace calc {
+
+// The productions the parser predicts, in the order of its routines.
+enum production
+{
+    p_program,
+    p_stmt_list,
+    p_stmt_list_eps,
+    p_stmt_decl,
+    p_stmt_assign,
+    p_stmt_read,
+    p_stmt_write,
+    p_stmt_if,
+    p_stmt_while,
+    p_stmt_eps,
+    p_expr,
+    p_expr_eps,
+    p_term_tail,
+    p_term_tail_eps,
+    p_term,
+    p_term_eps,
+    p_factor_tail,
+    p_factor_tail_eps,
+    p_factor_leaf,
+    p_factor_paren,
+    p_factor_convert,
+    p_factor_eps,
+    p_add_op,
+    p_add_op_eps,
+    p_mul_op,
+    p_mul_op_eps,
+    p_cond,
+    p_cond_eps,
+    p_type,
+    p_type_eps,
+    p_relop,
+    p_relop_eps,
+    p_count
+};
+
+const char* const productions[] = {
+    "program --> stmt_list eof",
+    "stmt_list --> stmt ; stmt_list",
+    "stmt_list --> epsilon",
+    "stmt --> type id := expr",
+    "stmt --> id := expr",
+    "stmt --> read type id",
+    "stmt --> write expr",
+    "stmt --> if C then stmt_list end",
+    "stmt --> while C do stmt_list end",
+    "stmt --> epsilon",
+    "expr --> term term_tail",
+    "expr --> epsilon",
+    "term_tail --> add_op term term_tail",
+    "term_tail --> epsilon",
+    "term --> factor factor_tail",
+    "term --> epsilon",
+    "factor_tail --> mul_op factor factor_tail",
+    "factor_tail --> epsilon",
+    "factor --> inum | rnum | id",
+    "factor --> lparen expr rparen",
+    "factor --> trunc | float lparen expr rparen",
+    "factor --> epsilon",
+    "add_op --> add | sub",
+    "add_op --> epsilon",
+    "mul_op --> mul | div",
+    "mul_op --> epsilon",
+    "C --> expr relop expr",
+    "C --> epsilon",
+    "type --> int | real",
+    "type --> epsilon",
+    "relop --> == | <> | < | > | <= | >=",
+    "relop --> epsilon"
+};
+
+enum trace_event
+{
+    e_predict,      // what is the production; token is the one that chose it
+    e_match,        // the parser matched token
+    e_scan,         // the scanner returned token
+    e_skip,         // error recovery skipped input up to offset
+    e_error         // a diagnostic was reported at offset
+};
+
+const char* const trace_events[] = {"predict", "match", "scan", "skip", "error"};
+
+struct trace_record
+{
+    uint64_t nanos;     // since tracing started
+    uint32_t offset;    // byte offset in the input
+    uint16_t what;      // production, for e_predict
+    uint8_t event;      // trace_event
+    uint8_t token;
+};
+static_assert(sizeof(trace_record) == 16, "trace records must stay 16 bytes");
+
+// Start of a trace file.  The records follow, oldest first, in the
+// byte order of the machine that wrote them.
+struct trace_header
+{
+    char magic[8];      // "calctrc1"
+    uint64_t total;     // events recorded, including those overwritten
+    uint32_t records;   // records in the file
+    uint32_t record_size;
+};
+
+struct no_trace
+{
+    void predict (unsigned, unsigned, uint32_t) {}
+    void match (unsigned, uint32_t) {}
+    void scan (unsigned, uint32_t) {}
+    void skip (uint32_t) {}
+    void error (uint32_t) {}
+};
+
+class ring_trace
+{
+    typedef std::chrono::steady_clock clock;
+
+    std::vector<trace_record> ring;     // size is a power of two
+    uint64_t total = 0;
+    clock::time_point epoch;
+
+    void add (trace_event e, unsigned what, unsigned tok, uint32_t offset) {
+        uint64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             clock::now() - epoch).count();
+        ring[total++ & (ring.size() - 1)] = trace_record{nanos, offset, uint16_t(what),
+                                                         uint8_t(e), uint8_t(tok)};
+    }
+
+public:
+    // Keeps the last capacity events, rounded up to a power of two.
+    explicit ring_trace (size_t capacity = 1 << 20);
+
+    void predict (unsigned p, unsigned tok, uint32_t offset) { add(e_predict, p, tok, offset); }
+    void match (unsigned tok, uint32_t offset) { add(e_match, 0, tok, offset); }
+    void scan (unsigned tok, uint32_t offset) { add(e_scan, 0, tok, offset); }
+    void skip (uint32_t offset) { add(e_skip, 0, 0, offset); }
+    void error (uint32_t offset) { add(e_error, 0, 0, offset); }
+
+    // Write a trace file; false if the stream failed.
+    bool write (std::ostream& out) const;
+};
+
+// Read a trace file written by ring_trace::write; false if it is not one.
+bool read_trace (std::istream& in, trace_header& header, std::vector<trace_record>& records);
+
+} // namespace calc
+
+#endif
@@ -0,0 +1,67 @@
+/* Decoder for the trace files written by parse --trace.
+   usage: tracedump trace [source]
+   Prints one event per line, oldest first.  Given the source that was
+   traced, it places each event by line and column, not byte offset.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include "parse.hpp"
+#include "trace.hpp"
+using std::setw;
+using namespace calc;
+
+int main (int argc, char* argv[]) {
+    if (argc < 2) {
+        cerr << "usage: " << argv[0] << " trace [source]" << endl;
+        return 2;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    trace_header header;
+    vector<trace_record> records;
+    if (!in || !read_trace(in, header, records)) {
+        cerr << argv[1] << " is not a readable trace file" << endl;
+        return 2;
+    }
+
+    line_index lines;
+    bool placed = argc > 2;
+    if (placed) {
+        std::ifstream source(argv[2], std::ios::binary);
+        if (!source) {
+            cerr << "cannot open " << argv[2] << endl;
+            return 2;
+        }
+        char buf[1 << 16];
+        src_offset consumed = 0;
+        while (source.read(buf, sizeof buf) || source.gcount() > 0) {
+            for (std::streamsize i = 0; i < source.gcount(); i++)
+                if (buf[i] == '\n')
+                    lines.add(consumed + i + 1);
+            consumed += source.gcount();
+        }
+    }
+
+    if (header.total > records.size())
+        cout << "(" << header.total - records.size() << " earlier events overwritten)" << endl;
+    for (const trace_record& r : records) {
+        cout << setw(12) << r.nanos << " ns  ";
+        if (placed)
+            cout << lines.locate(r.offset);
+        else
+            cout << "offset " << r.offset;
+        cout << "  " << (r.event <= e_error ? trace_events[r.event] : "?");
+        switch (r.event) {
+            case e_predict:
+                cout << " " << (r.what < p_count ? productions[r.what] : "?");
+                // fall through
+            case e_match:
+            case e_scan:
+                cout << " [" << (r.token <= t_eof ? names[r.token] : "?") << "]";
+                break;
+        }
+        cout << '\n';
+    }
+    return 0;
+}